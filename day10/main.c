@@ -1,132 +1,160 @@
+#define _GNU_SOURCE
+
 #include <stdint.h>
 #include <sys/types.h>
 
 #include "aoc.h"
+#include "aoc_batch.h"
+#include "aoc_bin.h"
+#include "aoc_queue.h"
+#include "aoc_trace.h"
 
-static void
-check(int cond, const char *expr, int line)
-{
-  if (!cond) {
-    fprintf(stderr, "assertion failed: %s (line %d)\n", expr, line);
-    exit(1);
-  }
-}
-
-#define ASSERT(c) check((c), #c, __LINE__)
-
-#define MAX_H 200u
-#define MAX_W 200u
-#define MAX_CELLS (MAX_H *MAX_W)
-
+// heights two per byte, low nibble first, rows stride bytes apart: the
+// aoc_bin.h AOC_BIN_NIBBLES layout, so a converted input is used in place
 struct topo {
-  int8_t grid[MAX_H][MAX_W];
+  const uint8_t *cell;
+  size_t stride;
   size_t h;
   size_t w;
 };
 
-struct pos {
-  uint16_t y;
-  uint16_t x;
-};
-    
+static inline int
+height(const struct topo *t, size_t y, size_t x)
+{
+  return (int)aoc_bin_nibble(t->cell + y * t->stride, x);
+}
+
 // 4-way neighbors
 static const int dy[4] = { -1, 1, 0, 0 };
 static const int dx[4] = { 0, 0, -1, 1 };
 
-static void
-parse_topo(struct topo *t, const struct aoc_buf *b)
+// does t hold exactly the digits of the text map s? (paranoid check)
+static int
+topo_matches(const struct topo *t, const char *s)
+{
+  for (size_t y = 0u; y < t->h; y++, s++) {
+    for (size_t x = 0u; x < t->w; x++, s++) {
+      if (height(t, y, x) != *s - '0') {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+// parse the text map into *store (freed by the caller), validating
+// every byte; NULL on success, else what was wrong with it
+static const char *
+parse_topo(struct topo *t, const struct aoc_buf *b, uint8_t **store)
 {
   size_t row = 0u;
   size_t col = 0u;
-  size_t width = 0u;
+  size_t width;
+  size_t rows = 1u;
+  uint8_t *p;
   const char *s;
 
-  ASSERT(t != NULL);
-  ASSERT(b != NULL);
-  ASSERT(b->p != NULL);
+  DASSERT(t != NULL);
+  DASSERT(b != NULL);
+  DASSERT(b->p != NULL);
 
   s = b->p;
+  width = strcspn(s, "\n");
+  if (width == 0u) {
+    return "empty first row";
+  }
+  for (size_t i = 0u; s[i] != '\0'; i++) {
+    rows += s[i] == '\n';
+  }
+  if (rows * width > UINT32_MAX) {   // fifo ids are y * w + x
+    return "map too large";
+  }
+  t->stride = aoc_bin_stride(AOC_BIN_NIBBLES, (uint32_t)width);
+  p = aoc_new(NULL, uint8_t, rows * t->stride);
+  if (p == NULL) {
+    return "out of memory";
+  }
+  memset(p, 0, rows * t->stride);
 
-  for (size_t i = 0u; s[i] != '\0';i++) {
+  for (size_t i = 0u; s[i] != '\0'; i++) {
     char c = s[i];
     if (c == '\n') {
-      ASSERT(col > 0u);
-      if (row == 0u) {
-        width = col;
-      } else {
-        ASSERT(col == width);
+      if (col != width) {
+        free(p);
+        return "ragged row";
       }
       row++;
-      ASSERT(row < MAX_H);
       col = 0u;
+    } else if (c < '0' || c > '9') {
+      free(p);
+      return "not a height";
+    } else if (col == width) {
+      free(p);
+      return "ragged row";
     } else {
-      ASSERT(c >= '0' && c <= '9');
-      ASSERT(col < MAX_W);
-      t->grid[row][col] = (int8_t)(c - '0');
+      p[row * t->stride + col / 2u] |= (uint8_t)((c - '0') << (col % 2u * 4u));
       col++;
     }
   }
-
-  if (col > 0u) {
-    if (row == 0u) {
-      width = col;
-    } else {
-      ASSERT(col == width);
-    }
-    row++;
+  if (col != width) {
+    free(p);
+    return "ragged row";
   }
-  ASSERT(row > 0u);
-  ASSERT(width > 0u);
-  ASSERT(row <= MAX_H);
-  ASSERT(width <= MAX_W);
+  row++;
+  DASSERT(row == rows);
 
+  t->cell = p;
   t->h = row;
   t->w = width;
+  PASSERT(topo_matches(t, s));
+  *store = p;
+  return NULL;
+}
 
-  ASSERT(t->h <= MAX_H);
-  ASSERT(t->w <= MAX_W);
+// map a converted input (convert topo) and use it in place
+static void
+load_topo(struct topo *t, struct aoc_bin_map *m, const char *fn)
+{
+  if (!aoc_bin_open(m, fn, AOC_BIN_NIBBLES, 0)) {
+    fprintf(stderr, "%s: %s\n", fn, m->err);
+    exit(1);
+  }
+  t->cell = m->data;
+  t->stride = m->hdr->stride;
+  t->h = m->hdr->rows;
+  t->w = m->hdr->cols;
+  ASSERT(t->h * t->w <= UINT32_MAX);
 }
 
-// compute the score for a single trailhead (sy, sx)
+// compute the score for a single trailhead (sy, sx); q, visited and
+// reached9 (h * w each) are scratch, where a cell counts as marked when
+// it holds this trailhead's stamp, so nothing is cleared between calls
 static uint64_t
-trailhead_score(const struct topo *t, size_t sy, size_t sx)
+trailhead_score(const struct topo *t, struct aoc_fifo *q, uint32_t *visited,
+                uint32_t *reached9, uint32_t stamp, size_t sy, size_t sx)
 {
-  struct pos queue[MAX_CELLS];
-  uint8_t visited[MAX_H][MAX_W];
-  uint8_t reached9[MAX_H][MAX_W];
-  size_t head = 0u;
-  size_t tail = 0u;
+  uint32_t cell;
   uint64_t score = 0u;
 
-  ASSERT(t != NULL);
-  ASSERT(sy < t->h);
-  ASSERT(sx < t->w);
-  ASSERT(t->grid[sy][sx] == 0);
-
-  for (size_t y = 0u; y < t->h; y++) {
-    for (size_t x = 0u; x < t->w; x++) {
-      visited[y][x] = 0u;
-      reached9[y][x] = 0u;
-    }
-  }
-  queue[tail].y = (uint16_t)sy;
-  queue[tail].x = (uint16_t)sx;
-  tail++;
-  visited[sy][sx] = 1u;
-
-  ASSERT(tail <= MAX_CELLS);
+  DASSERT(t != NULL);
+  DASSERT(q != NULL);
+  DASSERT(sy < t->h);
+  DASSERT(sx < t->w);
+  DASSERT(height(t, sy, sx) == 0);
 
-  while (head < tail) {
-    struct pos p = queue[head];
-    uint16_t y = p.y;
-    uint16_t x = p.x;
-    int8_t h = t->grid[y][x];
+  DASSERT(stamp != 0u);
+  aoc_fifo_clear(q);
+  ASSERT(aoc_fifo_push(q, (uint32_t)(sy * t->w + sx)));
+  visited[sy * t->w + sx] = stamp;
 
-    head++;
+  while (aoc_fifo_pop(q, &cell)) {
+    size_t y = cell / t->w;
+    size_t x = cell % t->w;
+    int h = height(t, y, x);
 
     if (h == 9) {
-      if (reached9[y][x] == 0u) {
-        reached9[y][x] = 1u;
+      if (reached9[y * t->w + x] != stamp) {
+        reached9[y * t->w + x] = stamp;
         score++;
       }
       continue;
@@ -142,61 +170,69 @@ trailhead_score(const struct topo *t, size_t sy, size_t sx)
       if ((size_t)ny >= t->h || (size_t)nx >= t->w) {
         continue;
       }
-      if (visited[ny][nx] != 0u &&
-          t->grid[ny][nx] == h + 1) {
+      if (visited[ny * t->w + nx] == stamp &&
+          height(t, ny, nx) == h + 1) {
         // we visited this cell; don't add it
         continue;
       }
-      if (t->grid[ny][nx] == h + 1) {
-        visited[ny][nx] = 1u;
-        queue[tail].y = (uint16_t)ny;
-        queue[tail].x = (uint16_t)nx;
-        tail++;
-        ASSERT(tail <= MAX_CELLS);
+      if (height(t, ny, nx) == h + 1) {
+        visited[ny * t->w + nx] = stamp;
+        ASSERT(aoc_fifo_push(q, (uint32_t)((size_t)ny * t->w + (size_t)nx)));
       }
     }
   }
-  ASSERT(score <= (uint64_t)t->h * t->w);
+  DASSERT(score <= (uint64_t)t->h * t->w);
   return score;
 }
 
 static uint64_t
 solve_part1(const struct topo *t)
 {
+  struct aoc_fifo q;
+  uint32_t *visited;
+  uint32_t *reached9;
+  uint32_t stamp = 0u;
   uint64_t total = 0u;
-  ASSERT(t != NULL);
+  DASSERT(t != NULL);
+  ASSERT(aoc_fifo_init(&q, NULL, t->w));
+  visited = aoc_new(NULL, uint32_t, t->h * t->w);
+  reached9 = aoc_new(NULL, uint32_t, t->h * t->w);
+  ASSERT(visited != NULL && reached9 != NULL);
+  memset(visited, 0, t->h * t->w * sizeof *visited);
+  memset(reached9, 0, t->h * t->w * sizeof *reached9);
 
   for (size_t y = 0u; y < t->h; y++) {
     for (size_t x = 0u; x < t->w; x++) {
-      if (t->grid[y][x] == 0) {
-        uint64_t sc = trailhead_score(t, y, x);
-        total += sc;
+      if (height(t, y, x) == 0) {
+        AOC_TRACE_SCOPE("trailhead") {
+          total += trailhead_score(t, &q, visited, reached9, ++stamp, y, x);
+        }
       }
     }
   }
-  ASSERT(total);
+  aoc_fifo_free(&q);
+  free(visited);
+  free(reached9);
+  DASSERT(total);
   return total;
 }
 
 static uint64_t
 solve_part2(const struct topo *t)
 {
-  uint64_t ways[MAX_H][MAX_W];
+  uint64_t *ways = aoc_new(NULL, uint64_t, t->h * t->w);
   uint64_t total = 0u;
-  for (size_t y = 0u; y < t->h; y++) {
-    for (size_t x = 0u; x < t->w; x++) {
-      ways[y][x] = 0u;
-    }
-  }
+  ASSERT(ways != NULL);
+  memset(ways, 0, t->h * t->w * sizeof *ways);
 
   for (int h = 9; h >= 0; h--) {
     for (size_t y = 0u; y < t->h; y++) {
       for (size_t x = 0u; x < t->w; x++) {
-        if (t->grid[y][x] != h) {
+        if (height(t, y, x) != h) {
           continue;
         }
         if (h == 9) {
-          ways[y][x] = 1u;
+          ways[y * t->w + x] = 1u;
         } else {
           uint64_t sum = 0u;
           for (size_t k = 0u; k < 4u; k++) {
@@ -209,11 +245,11 @@ solve_part2(const struct topo *t)
             if ((size_t)ny >= t->h || (size_t)nx >= t->w) {
               continue;
             }
-            if (t->grid[ny][nx] == h + 1) {
-              sum += ways[ny][nx];
+            if (height(t, ny, nx) == h + 1) {
+              sum += ways[ny * t->w + nx];
             }
           }
-          ways[y][x] = sum;
+          ways[y * t->w + x] = sum;
         }
       }
     }
@@ -221,37 +257,173 @@ solve_part2(const struct topo *t)
   // sum the ratins
   for (size_t y = 0u; y < t->h; y++) {
     for (size_t x = 0u; x < t->w; x++) {
-      if (t->grid[y][x] == 0) {
-        total += ways[y][x];
+      if (height(t, y, x) == 0) {
+        total += ways[y * t->w + x];
       }
     }
   }
-  ASSERT(total);
+  free(ways);
+  DASSERT(total);
   return total;
 }
 
+// one batch input made ready to solve, by parse_file on the parse
+// stage's thread
+struct topo_job {
+  struct topo topo;
+  uint8_t *store;     // a text map's cells; a converted one stays in f.p
+  const char *err;
+};
+
+static void *
+parse_file(struct aoc_batch_file *f, void *arg)
+{
+  struct topo_job *j = aoc_new(NULL, struct topo_job, 1);
+  struct aoc_buf buf = { f->p, f->n };
+
+  (void)arg;
+  if (j == NULL) {
+    return NULL;
+  }
+  j->store = NULL;
+  j->err = NULL;
+  if (f->err) {
+    j->err = strerror(f->err);
+  } else if (f->n == 0u) {
+    j->err = "empty input";
+  } else if (f->n >= 4u && memcmp(f->p, AOC_BIN_MAGIC, 4) == 0) {
+    // converted: the payload is used where it was read
+    const struct aoc_bin_hdr *h = (const struct aoc_bin_hdr *)f->p;
+    j->err = aoc_bin_check(f->p, f->n, AOC_BIN_NIBBLES, 0);
+    if (!j->err) {
+      j->topo.cell = (const uint8_t *)f->p + sizeof *h;
+      j->topo.stride = h->stride;
+      j->topo.h = h->rows;
+      j->topo.w = h->cols;
+      if (j->topo.h * j->topo.w > UINT32_MAX) {
+        j->err = "map too large";
+      }
+    }
+  } else {
+    AOC_TRACE_SCOPE("parse") {
+      chomp(buf.p);
+      j->err = parse_topo(&j->topo, &buf, &j->store);
+    }
+  }
+  return j;
+}
+
+static void
+drop_job(void *parsed, void *arg)
+{
+  struct topo_job *j = parsed;
+
+  (void)arg;
+  if (j != NULL) {
+    free(j->store);
+    free(j);
+  }
+}
+
+// every input in a directory or manifest, text or converted: one NDJSON
+// record per file on stdout, throughput on stderr.  The next file is
+// parsed while this one is solved, and the ones after it read; a
+// malformed map gets an "error" record and the run goes on
+static int
+run_batch(const char *src)
+{
+  struct aoc_batch b;
+  struct aoc_batch_file f;
+
+  if (!aoc_batch_open(&b, src)) {
+    fprintf(stderr, "%s: cannot list inputs\n", src);
+    return 1;
+  }
+  (void)aoc_batch_parse(&b, parse_file, drop_job, NULL);   // else in line
+  while (aoc_batch_next(&b, &f)) {
+    struct topo_job *j = f.parsed;
+    double t0 = aoc_batch_clock();
+    uint64_t part1;
+    uint64_t part2;
+
+    printf("{\"file\":");
+    aoc_json_str(stdout, f.path);
+    if (j == NULL || j->err) {
+      printf(",\"error\":");
+      aoc_json_str(stdout, j ? j->err : "out of memory");
+      printf("}\n");
+      drop_job(j, NULL);
+      free(f.p);
+      continue;
+    }
+    AOC_TRACE_SCOPE("part 1") {
+      part1 = solve_part1(&j->topo);
+    }
+    AOC_TRACE_SCOPE("part 2") {
+      part2 = solve_part2(&j->topo);
+    }
+    printf(",\"part1\":%llu,\"part2\":%llu,\"ms\":%.3f}\n",
+           (unsigned long long)part1, (unsigned long long)part2,
+           (aoc_batch_clock() - t0) * 1e3);
+    drop_job(j, NULL);
+    free(f.p);
+  }
+  aoc_batch_report(&b, stderr);
+  aoc_batch_close(&b);
+  return 0;
+}
+
 int
-main(void)
+main(int argc, char *argv[])
 {
-  struct aoc_buf buf;
+  const char *fn = argc > 1 ? argv[1] : "input.txt";
+  struct aoc_buf buf = { 0 };
+  struct aoc_bin_map bin = { 0 };
   struct topo topo;
+  uint8_t *store = NULL;
   uint64_t part1;
   uint64_t part2;
 
-  int ok = read_file("input.txt", NULL, &buf);
-  if (!ok) {
-    fprintf(stderr, "read failed\n");
-    return 1;
+  if (argc == 3 && strcmp(argv[1], "-b") == 0) {
+    return run_batch(argv[2]);
+  }
+
+  // a converted input (lib/convert topo) needs no reading or parsing
+  if (aoc_bin_is(fn)) {
+    AOC_TRACE_SCOPE("map") {
+      load_topo(&topo, &bin, fn);
+    }
+  } else {
+    uint64_t t = aoc_trace_begin();
+    int ok = read_file(fn, NULL, &buf);
+    aoc_trace_end("read", t);
+    if (!ok) {
+      fprintf(stderr, "read failed\n");
+      return 1;
+    }
+    const char *err = NULL;
+    AOC_TRACE_SCOPE("parse") {
+      chomp(buf.p);
+      err = parse_topo(&topo, &buf, &store);
+    }
+    if (err) {
+      fprintf(stderr, "%s: %s\n", fn, err);
+      return 1;
+    }
   }
-  chomp(buf.p);
-  parse_topo(&topo, &buf);
 
-  part1 = solve_part1(&topo);
-  part2 = solve_part2(&topo);
+  AOC_TRACE_SCOPE("part 1") {
+    part1 = solve_part1(&topo);
+  }
+  AOC_TRACE_SCOPE("part 2") {
+    part2 = solve_part2(&topo);
+  }
 
   printf("Part 1: %llu\n", (unsigned long long)part1);
   printf("Part 2: %llu\n", (unsigned long long)part2);
 
+  aoc_bin_close(&bin);
+  free(store);
   free(buf.p);
   return 0;
 }
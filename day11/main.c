@@ -1,14 +1,29 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "aoc.h"
+#include "aoc_batch.h"
+#include "aoc_perf.h"
+#include "aoc_trace.h"
 
 #define MAX_INPUT_LEN 10000u
 #define MAX_STATES    1000000u
+#define MAX_HORIZONS  256u
+#define MAX_BLINKS    1000000u
+#define MAX_THREADS   256u
+#define NSHARD        256u  // power of two
+#define SHARD_BITS    8u
 #define PART1_STEPS   25u
 #define PART2_STEPS   75u
 
+typedef __uint128_t u128;
+
 struct state {
   uint64_t val;
   uint64_t count;
@@ -23,17 +38,47 @@ struct map {
 // pre-compute powers of 10 to split digits
 static uint64_t pow10_table[20];
 
-// basic hash function for uint64_t
-static size_t
-hash_u64(uint64_t x)
+// counts are kept modulo count_mod; 0 means exact 64-bit counts
+static uint64_t count_mod;
+
+// a + b for counts below count_mod (or exact, trapping on overflow)
+static inline uint64_t
+count_add(uint64_t a, uint64_t b)
+{
+  uint64_t c = a + b;
+
+  if (count_mod == 0u) {
+    if (c < a) {
+      fprintf(stderr, "stone count overflows 64 bits; use -M <modulus>\n");
+      exit(1);
+    }
+    return c;
+  }
+  // a, b < count_mod, so one subtraction suffices (also on wrap-around)
+  if (c < a || c >= count_mod) {
+    c -= count_mod;
+  }
+  return c;
+}
+
+// 64-bit finalizer mix (murmur3)
+static uint64_t
+hash_mix(uint64_t x)
 {
-  // mix 64-bit, then modulo table size
   x ^= x >> 33;
   x *= 0xff51afd7ed558ccdULL;
   x ^= x >> 33;
   x *= 0xc4ceb9fe1a85ec53ULL;
   x ^= x >> 33;
-  size_t hashed = (size_t)(x % (uint64_t)MAX_STATES);
+  return x;
+}
+
+// basic hash function for uint64_t
+static size_t
+hash_u64(uint64_t x)
+{
+  // mix 64-bit, then modulo table size
+  size_t hashed = (size_t)(hash_mix(x) % (uint64_t)MAX_STATES);
 
   return hashed;
 }
@@ -41,7 +86,7 @@ hash_u64(uint64_t x)
 static void
 map_clear(struct map *m)
 {
-  ASSERT(m != NULL);
+  DASSERT(m != NULL);
 
   for (size_t i = 0u; i < MAX_STATES; i++) {
     m->st[i].val = 0u;
@@ -49,7 +94,7 @@ map_clear(struct map *m)
     m->st[i].used = 0u;
   }
   m->size = 0u;
-  ASSERT(m->size == 0u);
+  DASSERT(m->size == 0u);
 }
 
 static void
@@ -58,8 +103,7 @@ map_add(struct map *m, uint64_t val, uint64_t delta)
   size_t idx;
   size_t start;
 
-  ASSERT(m != NULL);
-  ASSERT(delta > 0);
+  DASSERT(m != NULL);
 
   idx = hash_u64(val);
   start = idx;
@@ -72,18 +116,18 @@ map_add(struct map *m, uint64_t val, uint64_t delta)
       s->val = val;
       s->count = delta;
       m->size++;
-      ASSERT(m->size <= MAX_STATES);
+      DASSERT(m->size <= MAX_STATES);
       return;
     }
     if (s->val == val) {
-      s->count += delta;
+      s->count = count_add(s->count, delta);
       return;
     }
     idx++;
     if (idx == MAX_STATES) {
       idx = 0u;
     }
-    ASSERT(idx != start || probe + 1u < MAX_STATES);
+    DASSERT(idx != start || probe + 1u < MAX_STATES);
   }
   ASSERT(0); // should never happen UNLESS MAX_STATES is not large enough
 }
@@ -110,10 +154,10 @@ split_even_digits(uint64_t v, int digits,
   int half;
   uint64_t p10;
 
-  ASSERT(digits > 0);
-  ASSERT((digits & 1) == 0);
-  ASSERT(left != NULL);
-  ASSERT(right != NULL);
+  DASSERT(digits > 0);
+  DASSERT((digits & 1) == 0);
+  DASSERT(left != NULL);
+  DASSERT(right != NULL);
 
   half = digits / 2;
   p10 = pow10_table[half];
@@ -123,12 +167,46 @@ split_even_digits(uint64_t v, int digits,
   // leading zeroes automatically dropped by integer arithmetic
 }
 
+// apply the stone rules to one value, return the number of children
+static int
+blink(uint64_t v, uint64_t kids[2])
+{
+  if (v == 0u) {
+    // Rule 1: 0 -> 1
+    kids[0] = 1u;
+    return 1;
+  }
+  int d = count_digits(v);
+  if ((d & 1) == 0) {
+    // Rule 2: even digits -> split
+    split_even_digits(v, d, &kids[0], &kids[1]);
+    return 2;
+  }
+  // Rule 3: mult by 2024
+  __uint128_t tmp = (__uint128_t)v * 2024;
+  ASSERT(tmp <= ((__uint128_t)UINT64_MAX));
+  kids[0] = (uint64_t)tmp; // we're assuming no overflow here from the puzzle input
+  return 1;
+}
+
+// used slots, recounted (paranoid check against m->size)
+static size_t
+map_live(const struct map *m)
+{
+  size_t n = 0u;
+
+  for (size_t i = 0u; i < MAX_STATES; i++) {
+    n += m->st[i].used != 0u;
+  }
+  return n;
+}
+
 // apply one blink: src -> dst according to stone rules
 static void
 step(const struct map *src, struct map *dst)
 {
-  ASSERT(src != NULL);
-  ASSERT(dst != NULL);
+  DASSERT(src != NULL);
+  DASSERT(dst != NULL);
 
   map_clear(dst);
 
@@ -136,152 +214,1043 @@ step(const struct map *src, struct map *dst)
     if (!src->st[i].used) {
       continue;
     }
-    uint64_t v = src->st[i].val;
+    uint64_t kids[2];
     uint64_t c = src->st[i].count;
+    int nk = blink(src->st[i].val, kids);
 
-    if (v == 0u) {
-      // Rule 1: 0 -> 1
-      map_add(dst, 1u, c);
-    } else {
-      int d = count_digits(v);
-      if ((d &1) == 0) {
-        // Rule 2: even digits -> split
-        uint64_t left;
-        uint64_t right;
-        split_even_digits(v, d, &left, &right);
-        map_add(dst, left, c);
-        map_add(dst, right, c);
-      } else {
-        // Rule 3: mult by 2024
-        __uint128_t tmp = (__uint128_t)v * 2024;
-        ASSERT(tmp <= ( (__uint128_t)UINT64_MAX));
-        uint64_t nv = (uint64_t)tmp;
-        map_add(dst, nv, c); // we're assuming no overflow here from the puzzle input
-      }
+    for (int k = 0; k < nk; k++) {
+      map_add(dst, kids[k], c);
     }
   }
+  PASSERT(map_live(dst) == dst->size);
 }
 
-static void
-parse_initial(struct map *m, const struct aoc_buf *b)
+// parse whitespace-separated stones into out[] and their count into *n;
+// NULL on success, else what was wrong with the input
+static const char *
+parse_stones(const struct aoc_buf *b, uint64_t *out, size_t cap, size_t *n)
 {
   uint64_t v = 0u;
   int in_num = 0;
   const char *s;
 
-  ASSERT(m != NULL);
-  ASSERT(b != NULL);
-  ASSERT(b->p != NULL);
-  ASSERT(b->n < MAX_INPUT_LEN);
+  DASSERT(b != NULL);
+  DASSERT(b->p != NULL);
+  DASSERT(n != NULL);
+  if (b->n >= MAX_INPUT_LEN) {
+    return "input too long";
+  }
   s = b->p;
+  *n = 0u;
 
-  for (size_t i = 0u; i < b->n; i++) {
+  // chomp() may have ended the text early
+  for (size_t i = 0u; i < b->n && s[i] != '\0'; i++) {
     char c = s[i];
     if (c >= '0' && c <= '9') {
+      if (v > (UINT64_MAX - (uint64_t)(c - '0')) / 10u) {
+        return "stone too large";
+      }
       v = v * 10u + (uint64_t)(c - '0');
       in_num = 1;
-    } else {
+    } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
       if (in_num) {
-        map_add(m, v, 1u);
+        if (*n == cap) {
+          return "too many stones";
+        }
+        out[(*n)++] = v;
         v = 0u;
         in_num = 0;
       }
+    } else {
+      return "not a number";
     }
   }
   if (in_num) {
-    map_add(m, v, 1u);
+    if (*n == cap) {
+      return "too many stones";
+    }
+    out[(*n)++] = v;
   }
-  ASSERT(m->size > 0u);
+  return *n > 0u ? NULL : "no stones";
 }
 
-static uint64_t
+static void
+parse_initial(struct map *m, const uint64_t *stones, size_t n)
+{
+  DASSERT(m != NULL);
+
+  for (size_t i = 0u; i < n; i++) {
+    map_add(m, stones[i], 1u);
+  }
+  DASSERT(m->size > 0u);
+}
+
+static u128
 sum_counts(const struct map *m)
 {
-  uint64_t total = 0u;
-  ASSERT(m != NULL);
+  u128 total = 0u;
+  DASSERT(m != NULL);
+  DASSERT(m->size > 0u);
 
   for (size_t i = 0u; i < MAX_STATES; i++) {
     if (m->st[i].used) {
       total += m->st[i].count;
     }
   }
-  ASSERT(total);
-  return total;
+  return count_mod ? total % count_mod : total;
+}
+
+
+/*
+ * Dense-ID transition graph.
+ *
+ * Every distinct stone value is interned once into a dense id; the one
+ * or two child ids of a value are resolved the first time that value is
+ * live and cached from then on.  A blink is then a sparse push of counts
+ * over the live ids, so its cost is O(distinct live values) and the
+ * digit/split/multiply rule runs once per value instead of once per
+ * value per blink.
+ */
+#define NO_ID        UINT32_MAX
+#define GRAPH_INIT   1024u
+
+struct graph {
+  uint64_t *val;   // id -> stone value
+  uint32_t *kid;   // id -> kid[2*id], kid[2*id+1] (NO_ID: unresolved / none)
+  uint32_t *slot;  // open-addressing table: value hash -> id
+  size_t nslot;    // power of two, kept at most half full
+  size_t n;        // ids in use
+  size_t cap;      // capacity of val[] / kid[]
+};
+
+// one generation of counts, indexed by id; only live ids are flagged
+struct gen {
+  uint64_t *count;
+  uint8_t *on;
+  uint32_t *live;
+  size_t nlive;
+  size_t cap;
+};
+
+static void *
+xrealloc(void *p, size_t n)
+{
+  void *q = realloc(p, n);
+  if (!q) {
+    fprintf(stderr, "oom\n");
+    exit(1);
+  }
+  return q;
+}
+
+// stone totals for blinks 0..kmax
+static u128 *
+alloc_totals(size_t kmax)
+{
+  if (kmax >= SIZE_MAX / sizeof(u128)) {
+    fprintf(stderr, "oom\n");
+    exit(1);
+  }
+  return xrealloc(NULL, (kmax + 1u) * sizeof(u128));
 }
 
 static void
-map_copy(const struct map *src, struct map *dst)
+graph_init(struct graph *g)
 {
-  ASSERT(src != NULL);
-  ASSERT(dst != NULL);
-  for (size_t i = 0u; i < MAX_STATES; i++) {
-    dst->st[i] = src->st[i];
+  DASSERT(g != NULL);
+
+  g->n = 0u;
+  g->cap = GRAPH_INIT;
+  g->val = xrealloc(NULL, g->cap * sizeof *g->val);
+  g->kid = xrealloc(NULL, 2u * g->cap * sizeof *g->kid);
+  g->nslot = 2u * GRAPH_INIT;
+  g->slot = xrealloc(NULL, g->nslot * sizeof *g->slot);
+  memset(g->slot, 0xff, g->nslot * sizeof *g->slot);
+}
+
+static void
+graph_free(struct graph *g)
+{
+  free(g->val);
+  free(g->kid);
+  free(g->slot);
+}
+
+static void
+graph_rehash(struct graph *g)
+{
+  size_t mask;
+
+  g->nslot *= 2u;
+  g->slot = xrealloc(g->slot, g->nslot * sizeof *g->slot);
+  memset(g->slot, 0xff, g->nslot * sizeof *g->slot);
+  mask = g->nslot - 1u;
+
+  for (uint32_t id = 0u; id < g->n; id++) {
+    size_t idx = (size_t)hash_mix(g->val[id]) & mask;
+    while (g->slot[idx] != NO_ID) {
+      idx = (idx + 1u) & mask;
+    }
+    g->slot[idx] = id;
+  }
+}
+
+// return the id of v, interning it if it is new
+static uint32_t
+graph_intern(struct graph *g, uint64_t v)
+{
+  size_t mask;
+  size_t idx;
+  uint32_t id;
+
+  DASSERT(g != NULL);
+
+  mask = g->nslot - 1u;
+  idx = (size_t)hash_mix(v) & mask;
+  while (g->slot[idx] != NO_ID) {
+    if (g->val[g->slot[idx]] == v) {
+      return g->slot[idx];
+    }
+    idx = (idx + 1u) & mask;
+  }
+
+  ASSERT(g->n < NO_ID);
+  if (g->n == g->cap) {
+    g->cap *= 2u;
+    g->val = xrealloc(g->val, g->cap * sizeof *g->val);
+    g->kid = xrealloc(g->kid, 2u * g->cap * sizeof *g->kid);
+  }
+  id = (uint32_t)g->n++;
+  g->val[id] = v;
+  g->kid[2u * id] = NO_ID;
+  g->kid[2u * id + 1u] = NO_ID;
+  g->slot[idx] = id;
+
+  if (2u * g->n > g->nslot) {
+    graph_rehash(g);
   }
-  dst->size = src->size;
+  return id;
 }
 
+// resolve and cache the children of id (no-op once resolved)
+static void
+graph_expand(struct graph *g, uint32_t id)
+{
+  uint64_t kids[2];
+  uint32_t a;
+  uint32_t b = NO_ID;
+
+  DASSERT(id < g->n);
+  if (g->kid[2u * id] != NO_ID) {
+    return;
+  }
+  int nk = blink(g->val[id], kids);
+  a = graph_intern(g, kids[0]);
+  if (nk == 2) {
+    b = graph_intern(g, kids[1]);
+  }
+  // interning may have reallocated kid[]
+  g->kid[2u * id] = a;
+  g->kid[2u * id + 1u] = b;
+}
+
+static void
+gen_init(struct gen *s)
+{
+  s->count = NULL;
+  s->on = NULL;
+  s->live = NULL;
+  s->nlive = 0u;
+  s->cap = 0u;
+}
+
+static void
+gen_free(struct gen *s)
+{
+  free(s->count);
+  free(s->on);
+  free(s->live);
+}
+
+// make room for ids < cap, new slots zeroed
+static void
+gen_fit(struct gen *s, size_t cap)
+{
+  if (s->cap >= cap) {
+    return;
+  }
+  s->count = xrealloc(s->count, cap * sizeof *s->count);
+  s->on = xrealloc(s->on, cap * sizeof *s->on);
+  s->live = xrealloc(s->live, cap * sizeof *s->live);
+  memset(s->count + s->cap, 0, (cap - s->cap) * sizeof *s->count);
+  memset(s->on + s->cap, 0, (cap - s->cap) * sizeof *s->on);
+  s->cap = cap;
+}
+
+// live[] lists exactly the ids flagged on, once each, and nothing else
+// holds a count (paranoid check)
+static int
+gen_consistent(const struct gen *s)
+{
+  size_t on = 0u;
+
+  for (size_t i = 0u; i < s->nlive; i++) {
+    if (!s->on[s->live[i]]) {
+      return 0;
+    }
+  }
+  for (size_t id = 0u; id < s->cap; id++) {
+    if (!s->on[id] && s->count[id] != 0u) {
+      return 0;
+    }
+    on += s->on[id] != 0u;
+  }
+  return on == s->nlive;
+}
+
+static void
+gen_add(struct gen *s, uint32_t id, uint64_t delta)
+{
+  DASSERT(id < s->cap);
+
+  if (!s->on[id]) {
+    s->on[id] = 1u;
+    s->live[s->nlive++] = id;
+  }
+  s->count[id] = count_add(s->count[id], delta);
+}
+
+// apply one blink over the graph: src -> dst, src is left empty
+static void
+graph_step(struct graph *g, struct gen *src, struct gen *dst)
+{
+  DASSERT(g != NULL);
+  DASSERT(src != NULL);
+  DASSERT(dst != NULL);
+  DASSERT(dst->nlive == 0u);
+
+  for (size_t i = 0u; i < src->nlive; i++) {
+    graph_expand(g, src->live[i]);
+  }
+  gen_fit(dst, g->cap);
+
+  for (size_t i = 0u; i < src->nlive; i++) {
+    uint32_t id = src->live[i];
+    uint64_t c = src->count[id];
+    uint32_t a = g->kid[2u * id];
+    uint32_t b = g->kid[2u * id + 1u];
+
+    gen_add(dst, a, c);
+    if (b != NO_ID) {
+      gen_add(dst, b, c);
+    }
+    src->count[id] = 0u;
+    src->on[id] = 0u;
+  }
+  src->nlive = 0u;
+  PASSERT(gen_consistent(src) && gen_consistent(dst));
+}
+
+static void
+graph_parse_initial(struct graph *g, struct gen *s,
+                    const uint64_t *stones, size_t n)
+{
+  DASSERT(g != NULL);
+  DASSERT(s != NULL);
+
+  for (size_t i = 0u; i < n; i++) {
+    uint32_t id = graph_intern(g, stones[i]);
+    gen_fit(s, g->cap);
+    gen_add(s, id, 1u);
+  }
+  DASSERT(s->nlive > 0u);
+}
+
+static u128
+gen_sum(const struct gen *s)
+{
+  u128 total = 0u;
+  DASSERT(s != NULL);
+  DASSERT(s->nlive > 0u);
+
+  for (size_t i = 0u; i < s->nlive; i++) {
+    total += s->count[s->live[i]];
+  }
+  return count_mod ? total % count_mod : total;
+}
 
-static struct map g_init_map;
 static struct map g_work0;
 static struct map g_work1;
 
+/*
+ * Sharded parallel engine.
+ *
+ * The value space is split into NSHARD hash shards, each its own small
+ * open-addressing table over dense (val, count) arrays.  A blink runs in
+ * two phases separated by a barrier:
+ *
+ *   emit:  thread t blinks the live entries of the src shards it owns
+ *          and appends (child, count) pairs to its own buffer for the
+ *          child's dst shard;
+ *   merge: thread t rebuilds the dst shards it owns from every thread's
+ *          buffer for that shard, in thread order.
+ *
+ * No table is ever written by two threads, so no locks are needed, and
+ * since counts only meet through (modular) addition the totals are
+ * bit-identical to the sequential engines.
+ */
+struct pair {
+  uint64_t val;
+  uint64_t count;
+};
+
+struct pairbuf {
+  struct pair *p;
+  size_t n;
+  size_t cap;
+};
+
+struct shard {
+  uint64_t *val;
+  uint64_t *count;
+  size_t n;
+  size_t cap;
+  uint32_t *slot;  // value hash -> entry index, NO_ID when empty
+  size_t nslot;    // power of two, kept at most half full
+};
+
+struct smap {
+  struct shard sh[NSHARD];
+};
+
+struct pool {
+  pthread_barrier_t bar;
+  size_t nthreads;
+  size_t kmax;
+  struct smap *maps[2];
+  struct pairbuf (*out)[NSHARD];  // out[thread][dst shard]
+  u128 partial[NSHARD];
+  u128 *totals;
+};
+
+struct worker {
+  struct pool *pool;
+  size_t id;
+};
+
+static size_t
+shard_of(uint64_t h)
+{
+  return (size_t)(h >> (64u - SHARD_BITS));
+}
+
+static void
+shard_init(struct shard *sh)
+{
+  sh->n = 0u;
+  sh->cap = 16u;
+  sh->val = xrealloc(NULL, sh->cap * sizeof *sh->val);
+  sh->count = xrealloc(NULL, sh->cap * sizeof *sh->count);
+  sh->nslot = 32u;
+  sh->slot = xrealloc(NULL, sh->nslot * sizeof *sh->slot);
+  memset(sh->slot, 0xff, sh->nslot * sizeof *sh->slot);
+}
+
+static void
+shard_free(struct shard *sh)
+{
+  free(sh->val);
+  free(sh->count);
+  free(sh->slot);
+}
+
+static void
+shard_clear(struct shard *sh)
+{
+  if (sh->n > 0u) {
+    memset(sh->slot, 0xff, sh->nslot * sizeof *sh->slot);
+    sh->n = 0u;
+  }
+}
+
+static void
+shard_rehash(struct shard *sh)
+{
+  size_t mask;
+
+  sh->nslot *= 2u;
+  sh->slot = xrealloc(sh->slot, sh->nslot * sizeof *sh->slot);
+  memset(sh->slot, 0xff, sh->nslot * sizeof *sh->slot);
+  mask = sh->nslot - 1u;
+
+  for (uint32_t i = 0u; i < sh->n; i++) {
+    size_t idx = (size_t)hash_mix(sh->val[i]) & mask;
+    while (sh->slot[idx] != NO_ID) {
+      idx = (idx + 1u) & mask;
+    }
+    sh->slot[idx] = i;
+  }
+}
+
+static void
+shard_add(struct shard *sh, uint64_t h, uint64_t val, uint64_t delta)
+{
+  size_t mask = sh->nslot - 1u;
+  size_t idx = (size_t)h & mask;
+
+  while (sh->slot[idx] != NO_ID) {
+    uint32_t i = sh->slot[idx];
+    if (sh->val[i] == val) {
+      sh->count[i] = count_add(sh->count[i], delta);
+      return;
+    }
+    idx = (idx + 1u) & mask;
+  }
+
+  ASSERT(sh->n < NO_ID);
+  if (sh->n == sh->cap) {
+    sh->cap *= 2u;
+    sh->val = xrealloc(sh->val, sh->cap * sizeof *sh->val);
+    sh->count = xrealloc(sh->count, sh->cap * sizeof *sh->count);
+  }
+  sh->slot[idx] = (uint32_t)sh->n;
+  sh->val[sh->n] = val;
+  sh->count[sh->n] = delta;
+  sh->n++;
+
+  if (2u * sh->n > sh->nslot) {
+    shard_rehash(sh);
+  }
+}
+
+static void
+smap_add(struct smap *m, uint64_t val, uint64_t delta)
+{
+  uint64_t h = hash_mix(val);
+  shard_add(&m->sh[shard_of(h)], h, val, delta);
+}
+
+static void
+pairbuf_push(struct pairbuf *b, uint64_t val, uint64_t count)
+{
+  if (b->n == b->cap) {
+    b->cap = b->cap ? 2u * b->cap : 64u;
+    b->p = xrealloc(b->p, b->cap * sizeof *b->p);
+  }
+  b->p[b->n].val = val;
+  b->p[b->n].count = count;
+  b->n++;
+}
+
+static u128
+shard_sum(const struct shard *sh)
+{
+  u128 total = 0u;
+
+  for (size_t i = 0u; i < sh->n; i++) {
+    total += sh->count[i];
+  }
+  return total;
+}
+
+static void *
+pool_run(void *arg)
+{
+  struct worker *w = arg;
+  struct pool *pl = w->pool;
+  size_t t = w->id;
+  size_t nt = pl->nthreads;
+  struct smap *cur = pl->maps[0];
+  struct smap *next = pl->maps[1];
+  char name[32];   // a trace row name; t < MAX_THREADS
+
+  if (t > 0u) {
+    // the caller keeps its "main" row
+    snprintf(name, sizeof name, "shard worker %u", (unsigned)t);
+    aoc_trace_thread_name(name);
+  }
+  for (size_t step_idx = 1u; step_idx <= pl->kmax; step_idx++) {
+    uint64_t tr = aoc_trace_begin();
+
+    // emit
+    for (size_t s = t; s < NSHARD; s += nt) {
+      const struct shard *sh = &cur->sh[s];
+      for (size_t i = 0u; i < sh->n; i++) {
+        uint64_t kids[2];
+        int nk = blink(sh->val[i], kids);
+        for (int k = 0; k < nk; k++) {
+          size_t ds = shard_of(hash_mix(kids[k]));
+          pairbuf_push(&pl->out[t][ds], kids[k], sh->count[i]);
+        }
+      }
+    }
+    aoc_trace_end("emit", tr);
+    pthread_barrier_wait(&pl->bar);
+
+    // merge
+    tr = aoc_trace_begin();
+    for (size_t s = t; s < NSHARD; s += nt) {
+      struct shard *sh = &next->sh[s];
+      shard_clear(sh);
+      for (size_t u = 0u; u < nt; u++) {
+        struct pairbuf *b = &pl->out[u][s];
+        for (size_t i = 0u; i < b->n; i++) {
+          uint64_t h = hash_mix(b->p[i].val);
+          shard_add(sh, h, b->p[i].val, b->p[i].count);
+        }
+        b->n = 0u;
+      }
+      pl->partial[s] = shard_sum(sh);
+    }
+    aoc_trace_end("merge", tr);
+    pthread_barrier_wait(&pl->bar);
+
+    // partial[] is next rewritten after the following emit barrier
+    if (t == 0u) {
+      u128 total = 0u;
+      for (size_t s = 0u; s < NSHARD; s++) {
+        total += pl->partial[s];
+      }
+      pl->totals[step_idx] = count_mod ? total % count_mod : total;
+    }
+    struct smap *tmp = cur;
+    cur  = next;
+    next = tmp;
+  }
+  return NULL;
+}
+
+// sharded engine on nthreads threads (the caller is thread 0)
+static void
+sweep_shard(const uint64_t *stones, size_t n, size_t kmax, u128 *totals,
+            size_t nthreads)
+{
+  struct pool pl;
+  struct worker w[MAX_THREADS];
+  pthread_t tid[MAX_THREADS];
+  struct smap *maps;
+  u128 total = 0u;
+
+  ASSERT(nthreads > 0u && nthreads <= MAX_THREADS);
+
+  maps = xrealloc(NULL, 2u * sizeof *maps);
+  for (size_t s = 0u; s < NSHARD; s++) {
+    shard_init(&maps[0].sh[s]);
+    shard_init(&maps[1].sh[s]);
+  }
+  for (size_t i = 0u; i < n; i++) {
+    smap_add(&maps[0], stones[i], 1u);
+  }
+  for (size_t s = 0u; s < NSHARD; s++) {
+    total += shard_sum(&maps[0].sh[s]);
+  }
+  totals[0] = count_mod ? total % count_mod : total;
+
+  pl.nthreads = nthreads;
+  pl.kmax = kmax;
+  pl.maps[0] = &maps[0];
+  pl.maps[1] = &maps[1];
+  pl.totals = totals;
+  pl.out = xrealloc(NULL, nthreads * sizeof *pl.out);
+  memset(pl.out, 0, nthreads * sizeof *pl.out);
+  if (pthread_barrier_init(&pl.bar, NULL, (unsigned)nthreads) != 0) {
+    fprintf(stderr, "pthread_barrier_init failed\n");
+    exit(1);
+  }
+
+  for (size_t t = 0u; t < nthreads; t++) {
+    w[t].pool = &pl;
+    w[t].id = t;
+  }
+  for (size_t t = 1u; t < nthreads; t++) {
+    if (pthread_create(&tid[t], NULL, pool_run, &w[t]) != 0) {
+      fprintf(stderr, "pthread_create failed\n");
+      exit(1);
+    }
+  }
+  pool_run(&w[0]);
+  for (size_t t = 1u; t < nthreads; t++) {
+    pthread_join(tid[t], NULL);
+  }
+
+  pthread_barrier_destroy(&pl.bar);
+  for (size_t t = 0u; t < nthreads; t++) {
+    for (size_t s = 0u; s < NSHARD; s++) {
+      free(pl.out[t][s].p);
+    }
+  }
+  free(pl.out);
+  for (size_t s = 0u; s < NSHARD; s++) {
+    shard_free(&maps[0].sh[s]);
+    shard_free(&maps[1].sh[s]);
+  }
+  free(maps);
+}
+
+/*
+ * Engines sweep blinks 0..kmax once and memoize the stone total after
+ * every blink in totals[], so any number of horizons costs one pass.
+ */
+
+// the original fixed-size hash map engine
+static void
+sweep_map(const uint64_t *stones, size_t n, size_t kmax, u128 *totals)
+{
+  struct map *cur = &g_work0;
+  struct map *next = &g_work1;
+
+  map_clear(cur);
+  parse_initial(cur, stones, n);
+  totals[0] = sum_counts(cur);
+
+  for (size_t step_idx = 1u; step_idx <= kmax; step_idx++) {
+    step(cur, next);
+    struct map *tmp = cur;
+    cur  = next;
+    next = tmp;
+    totals[step_idx] = sum_counts(cur);
+  }
+}
+
+// dense-ID graph engine
+static void
+sweep_graph(const uint64_t *stones, size_t n, size_t kmax, u128 *totals)
+{
+  struct graph g;
+  struct gen gens[2];
+  struct gen *cur = &gens[0];
+  struct gen *next = &gens[1];
+
+  graph_init(&g);
+  gen_init(&gens[0]);
+  gen_init(&gens[1]);
+  graph_parse_initial(&g, cur, stones, n);
+  totals[0] = gen_sum(cur);
+
+  for (size_t step_idx = 1u; step_idx <= kmax; step_idx++) {
+    graph_step(&g, cur, next);
+    struct gen *tmp = cur;
+    cur  = next;
+    next = tmp;
+    totals[step_idx] = gen_sum(cur);
+  }
+
+  gen_free(&gens[0]);
+  gen_free(&gens[1]);
+  graph_free(&g);
+}
+
+// v in decimal into buf (40 bytes covers 2^128)
+static const char *
+u128_str(char buf[40], u128 v)
+{
+  char *p = buf + 39;
+
+  *p = '\0';
+  do {
+    *--p = (char)('0' + (int)(v % 10u));
+    v /= 10u;
+  } while (v != 0u);
+  return p;
+}
+
+static void
+print_u128(const char *label, u128 v)
+{
+  char digits[40];
+
+  fputs(label, stdout);
+  puts(u128_str(digits, v));
+}
+
+// run the named engine; 0 for an unknown mode
+static int
+sweep(const char *mode, const uint64_t *stones, size_t n, size_t kmax,
+      u128 *totals, long nthreads)
+{
+  if (strcmp(mode, "graph") == 0) {
+    sweep_graph(stones, n, kmax, totals);
+  } else if (strcmp(mode, "map") == 0) {
+    sweep_map(stones, n, kmax, totals);
+  } else if (strcmp(mode, "shard") == 0) {
+    sweep_shard(stones, n, kmax, totals, (size_t)nthreads);
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+// one batch input's stones, parsed by parse_file on the parse stage's
+// thread
+struct stone_job {
+  uint64_t stones[MAX_INPUT_LEN / 2u];
+  size_t n;
+  const char *err;
+};
+
+static void *
+parse_file(struct aoc_batch_file *f, void *arg)
+{
+  struct stone_job *j = xrealloc(NULL, sizeof *j);
+  struct aoc_buf buf = { f->p, f->n };
+
+  (void)arg;
+  j->err = NULL;
+  if (f->err) {
+    j->err = strerror(f->err);
+  } else if (f->n == 0u) {
+    j->err = "empty input";
+  } else {
+    AOC_TRACE_SCOPE("parse") {
+      chomp(buf.p);
+      j->err = parse_stones(&buf, j->stones,
+                            sizeof j->stones / sizeof j->stones[0], &j->n);
+    }
+  }
+  return j;
+}
+
+static void
+drop_job(void *parsed, void *arg)
+{
+  (void)arg;
+  free(parsed);
+}
+
+// every input in a directory or manifest: one NDJSON record per file
+// on stdout (part1/part2, or a "blinks" object for -k), throughput on
+// stderr.  The next file is parsed while this one is swept, and the
+// ones after it read
+static int
+run_batch(const char *src, const char *mode, long nthreads, size_t kmax,
+          const size_t *ks, size_t nks)
+{
+  struct aoc_batch b;
+  struct aoc_batch_file f;
+  u128 *totals = alloc_totals(kmax);
+  char digits[40];
+
+  if (!aoc_batch_open(&b, src)) {
+    fprintf(stderr, "%s: cannot list inputs\n", src);
+    return 1;
+  }
+  (void)aoc_batch_parse(&b, parse_file, drop_job, NULL);   // else in line
+  while (aoc_batch_next(&b, &f)) {
+    struct stone_job *j = f.parsed;
+    double t0 = aoc_batch_clock();
+
+    printf("{\"file\":");
+    aoc_json_str(stdout, f.path);
+    if (j->err) {
+      printf(",\"error\":");
+      aoc_json_str(stdout, j->err);
+      printf("}\n");
+      drop_job(j, NULL);
+      free(f.p);
+      continue;
+    }
+    AOC_TRACE_SCOPE("parts 1+2") {
+      sweep(mode, j->stones, j->n, kmax, totals, nthreads);
+    }
+    if (nks == 0u) {
+      printf(",\"part1\":%s", u128_str(digits, totals[PART1_STEPS]));
+      printf(",\"part2\":%s", u128_str(digits, totals[PART2_STEPS]));
+    } else {
+      for (size_t i = 0u; i < nks; i++) {
+        printf("%s\"%zu\":%s", i ? "," : ",\"blinks\":{", ks[i],
+               u128_str(digits, totals[ks[i]]));
+      }
+      putchar('}');
+    }
+    printf(",\"ms\":%.3f}\n", (aoc_batch_clock() - t0) * 1e3);
+    drop_job(j, NULL);
+    free(f.p);
+  }
+  aoc_batch_report(&b, stderr);
+  aoc_batch_close(&b);
+  free(totals);
+  return 0;
+}
+
+// parse a comma-separated list of blink counts, each at most
+// MAX_BLINKS; return how many, 0 on anything else
+static size_t
+parse_horizons(const char *s, size_t *ks, size_t cap)
+{
+  size_t n = 0u;
+  unsigned long long k;
+  char *end;
+
+  while (*s) {
+    if (*s < '0' || *s > '9' || n == cap) {
+      return 0u;
+    }
+    errno = 0;
+    k = strtoull(s, &end, 10);
+    if (errno == ERANGE || k > MAX_BLINKS) {
+      return 0u;
+    }
+    ks[n++] = (size_t)k;
+    s = end;
+    if (*s == ',') {
+      s++;
+    } else if (*s) {
+      return 0u;
+    }
+  }
+  return n;
+}
+
+static void
+usage(const char *argv0)
+{
+  fprintf(stderr,
+          "usage: %s [-m graph|map|shard] [-j threads] [-k k1,k2,...] "
+          "[-M modulus] [-p] [-b dir|manifest | file]\n",
+          argv0);
+  exit(1);
+}
+
 int
-main(void)
+main(int argc, char *argv[])
 {
   struct aoc_buf buf;
-  struct map *cur;
-  struct map *next;
+  uint64_t stones[MAX_INPUT_LEN / 2u];
+  size_t nstones;
+  size_t ks[MAX_HORIZONS];
+  size_t nks = 0u;
+  size_t kmax = PART2_STEPS;
+  u128 *totals;
+  const char *fn = "input.txt";
+  const char *batch = NULL;
+  const char *mode = "graph";
+  long nthreads = 0;
+  bool perf = false;
+  struct aoc_perf pc;
+  struct aoc_perf_sample read_s, sweep_s;
+  double t0, t1, t2;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      mode = argv[++i];
+    } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      nks = parse_horizons(argv[++i], ks, MAX_HORIZONS);
+      if (nks == 0u) {
+        usage(argv[0]);
+      }
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      nthreads = strtol(argv[++i], NULL, 10);
+      if (nthreads <= 0 || nthreads > (long)MAX_THREADS) {
+        usage(argv[0]);
+      }
+    } else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc) {
+      count_mod = strtoull(argv[++i], NULL, 10);
+      if (count_mod == 0u) {
+        usage(argv[0]);
+      }
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      batch = argv[++i];
+    } else if (strcmp(argv[i], "-p") == 0) {
+      perf = true;
+    } else if (argv[i][0] == '-') {
+      usage(argv[0]);
+    } else {
+      fn = argv[i];
+    }
+  }
+  if (nks > 0u) {
+    kmax = 0u;
+    for (size_t i = 0u; i < nks; i++) {
+      if (ks[i] > kmax) {
+        kmax = ks[i];
+      }
+    }
+  }
+
+  if (strcmp(mode, "graph") != 0 && strcmp(mode, "map") != 0 &&
+      strcmp(mode, "shard") != 0) {
+    usage(argv[0]);
+  }
+  if (nthreads == 0) {
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0) {
+      nthreads = 1;
+    } else if (nthreads > (long)MAX_THREADS) {
+      nthreads = MAX_THREADS;
+    }
+  }
 
   // init pow10_table
   pow10_table[0] = 1u;
   for (int i = 1; i < 20; i++) {
     pow10_table[i] = pow10_table[i - 1] * 10u;
   }
-  int ok = read_file("input.txt", NULL, &buf);
+  if (batch) {
+    return run_batch(batch, mode, nthreads, kmax, ks, nks);
+  }
+  if (perf) {
+    aoc_perf_open(&pc, strcmp(mode, "shard") == 0 ? AOC_PERF_INHERIT : 0);
+  }
+  t0 = aoc_perf_ms();
+  if (perf) {
+    aoc_perf_start(&pc);
+  }
+  uint64_t tr = aoc_trace_begin();
+  int ok = read_file(fn, NULL, &buf);
+  aoc_trace_end("read", tr);
   if (!ok) {
     fprintf(stderr, "read failed\n");
     return 1;
   }
+  tr = aoc_trace_begin();
   chomp(buf.p);
-  map_clear(&g_init_map);
-  parse_initial(&g_init_map, &buf);
-
-  // Part 1
-  map_clear(&g_work0);
-  map_clear(&g_work1);
-  map_copy(&g_init_map, &g_work0);
+  const char *err = parse_stones(&buf, stones, sizeof stones / sizeof stones[0],
+                                 &nstones);
+  aoc_trace_end("parse", tr);
+  if (err) {
+    fprintf(stderr, "%s: %s\n", fn, err);
+    return 1;
+  }
+  if (perf) {
+    aoc_perf_stop(&pc, &read_s);
+    aoc_perf_start(&pc);
+  }
+  t1 = aoc_perf_ms();
 
-  cur = &g_work0;
-  next = &g_work1;
+  totals = alloc_totals(kmax);
+  // one sweep answers both parts (and every -k horizon)
+  tr = aoc_trace_begin();
+  sweep(mode, stones, nstones, kmax, totals, nthreads);
+  aoc_trace_end("parts 1+2", tr);
+  if (perf) {
+    aoc_perf_stop(&pc, &sweep_s);
+  }
+  t2 = aoc_perf_ms();
 
-  for (size_t step_idx = 0u; step_idx < PART1_STEPS; step_idx++) {
-    step(cur, next);
-    // swap
-    {
-      struct map *tmp = cur;
-      cur = next;
-      next = tmp;
+  if (nks == 0u) {
+    print_u128("Part 1: ", totals[PART1_STEPS]);
+    print_u128("Part 2: ", totals[PART2_STEPS]);
+  } else {
+    for (size_t i = 0u; i < nks; i++) {
+      char label[32];
+      snprintf(label, sizeof label, "%zu: ", ks[i]);
+      print_u128(label, totals[ks[i]]);
     }
   }
-  uint64_t part1 = sum_counts(cur);
-  
-  // Part 2
-  map_clear(&g_work0);
-  map_clear(&g_work1);
-  map_copy(&g_init_map, &g_work0);
-
-  cur  = &g_work0;
-  next = &g_work1;
 
-  for (size_t step_idx = 0u; step_idx < PART2_STEPS; step_idx++) {
-    step(cur, next);
-    struct map *tmp = cur;
-    cur  = next;
-    next = tmp;
+  if (perf) {
+    // counters on stderr so answers stay diffable
+    char why[96];
+    fprintf(stderr, "%s, %zu stones, %zu blinks:\n", mode, nstones, kmax);
+    if (pc.nopen == 0) {
+      fprintf(stderr, "  (no counters: %s)\n", aoc_perf_why(&pc, why, sizeof why));
+    }
+    aoc_perf_report(stderr, "read", t1 - t0, &read_s);
+    aoc_perf_report(stderr, "sweep", t2 - t1, &sweep_s);
+    aoc_perf_close(&pc);
   }
 
-  uint64_t part2 = sum_counts(cur);
-
-  printf("Part 1: %llu\n", (unsigned long long)part1);
-  printf("Part 2: %llu\n", (unsigned long long)part2);;
+  free(totals);
+  free(buf.p);
+  return 0;
 }
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+
+# Generate a day 16 style maze for benchmarking.
+#
+# usage: gen.py SIZE [SEED] [LOOP_PCT]
+#
+# Carves a perfect maze with an iterative randomized DFS on the odd
+# cells of a SIZE x SIZE grid, then knocks out LOOP_PCT percent of the
+# remaining inner walls so there are many equally good paths, like the
+# puzzle input.  S is bottom-left, E is top-right.
+
+import random
+import sys
+
+def carve(size, rng):
+    grid = [bytearray(b"#" * size) for _ in range(size)]
+    grid[1][1] = ord(".")
+    stack = [(1, 1)]
+    steps = ((-2, 0), (2, 0), (0, -2), (0, 2))
+
+    while stack:
+        r, c = stack[-1]
+        options = []
+        for dr, dc in steps:
+            nr, nc = r + dr, c + dc
+            if 0 < nr < size - 1 and 0 < nc < size - 1 and grid[nr][nc] == ord("#"):
+                options.append((nr, nc))
+        if not options:
+            stack.pop()
+            continue
+        nr, nc = rng.choice(options)
+        grid[(r + nr) // 2][(c + nc) // 2] = ord(".")
+        grid[nr][nc] = ord(".")
+        stack.append((nr, nc))
+    return grid
+
+def add_loops(grid, size, pct, rng):
+    for r in range(1, size - 1):
+        for c in range(1, size - 1):
+            if grid[r][c] != ord("#") or (r % 2) == (c % 2):
+                continue
+            if rng.randrange(100) < pct:
+                grid[r][c] = ord(".")
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit("usage: gen.py SIZE [SEED] [LOOP_PCT]")
+    size = int(sys.argv[1])
+    seed = int(sys.argv[2]) if len(sys.argv) > 2 else 16
+    pct = int(sys.argv[3]) if len(sys.argv) > 3 else 5
+    if size < 5:
+        sys.exit("SIZE must be at least 5")
+    if size % 2 == 0:
+        size += 1
+
+    rng = random.Random(seed)
+    grid = carve(size, rng)
+    add_loops(grid, size, pct, rng)
+    grid[size - 2][1] = ord("S")
+    grid[1][size - 2] = ord("E")
+
+    out = sys.stdout.buffer
+    for row in grid:
+        out.write(row)
+        out.write(b"\n")
+
+if __name__ == "__main__":
+    main()
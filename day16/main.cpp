@@ -1,11 +1,39 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <queue>
+#include <algorithm>
 #include <array>
 #include <limits>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <barrier>
+#include <fstream>
+#include <cerrno>
+#include <cstdio>
+#include <csignal>
+#include <new>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "aoc_batch.h"
+#include "aoc_bin.h"
+#include "aoc_perf.h"
+#include "aoc_trace.h"
+#include "gridsearch.hpp"
 
 using namespace std;
+using gridsearch::Dir;
+using gridsearch::DistArray;
+using gridsearch::HeapQueue;
+using gridsearch::IndexedHeap;
+using gridsearch::INF;
+using gridsearch::Node;
 
 /*
  * Advent of Code 2024 - Day 16: Reindeer Maze (Parts 1 & 2)
@@ -30,264 +58,1715 @@ using namespace std;
  *       dist_start[r][c][d] + dist_end[r][c][d] == best_cost
  *   where dist_end is computed via a Dijkstra on the reversed graph
  *   (from all (E, d) with distance 0).
+ *
+ * Layout:
+ *   The maze is stored flat with a one-cell wall border, so a cell is
+ *   p = (r + 1) * W + (c + 1) with W = C + 2, a step in direction d is
+ *   p + step[d], and no move ever needs a bounds check.  A state is
+ *   packed as p * 4 + d and distances live in one contiguous uint32_t
+ *   buffer per search (4 states x 4 bytes = 16 bytes per cell per search,
+ *   32 for the forward and reverse searches together).
+ *
+ * Searches:
+ *   The grid and junction searches are instances of the one Dijkstra
+ *   template in lib/gridsearch.hpp, specialised on the state encoding,
+ *   the 1/1000 cost policy, the neighbour generator (Moves, or the
+ *   JunctionGraph) and the queue; forward and reverse differ only in a
+ *   compile-time direction.
+ *
+ * Queues:
+ *   Edge costs are only 1 and 1000, so besides the binary heaps (lazy
+ *   deletion, or indexed with decrease-key and no duplicate entries)
+ *   the searches can run on a Dial bucket queue: 1001 circular buckets
+ *   of packed 32-bit state ids, O(1) push/pop, no log factor.
+ *   Select with --queue heap|iheap|dial (default dial); --bench N times all
+ *   engines and checks they agree, and also runs a fewest-turns search
+ *   (steps free, turns 1) on the heap, Dial and 0-1 deque queues.  --queue delta runs the parallel
+ *   delta-stepping engine on -j threads; --scale N reports its scaling
+ *   on 1, 2, 4, ... N threads.
+ *
+ * Counters:
+ *   --perf adds hardware counters (IPC, L1d/LLC/branch/dTLB misses per
+ *   thousand instructions, via lib/aoc_perf.h) to stderr: for reading
+ *   and solving, or with --bench for the best run of every engine.
+ *   Where perf_event_paranoid forbids them the lines say "n/a".
+ *
+ * Input:
+ *   The maze comes from stdin, or from --input FILE.  FILE (and the
+ *   --serve and --dynamic mazes) may also be a maze converted by
+ *   lib/convert, which loads with no parsing; see read_maze_bin.
+ *
+ * Tracing:
+ *   With AOC_TRACE=FILE the read, contraction, both searches, the tile
+ *   count bands and every delta-stepping bucket are written to FILE as
+ *   a Chrome trace-event timeline (lib/aoc_trace.h), one row per thread.
+ *
+ * Graph:
+ *   --graph junction (default) contracts corridors away first and
+ *   searches only junctions, dead ends, S and E; --graph grid searches
+ *   every (cell, dir) state.  See "Corridor contraction" below.
+ *
+ * Part 1 only:
+ *   --part 1 answers part 1 alone with an early-terminating A* over the
+ *   grid states; part 2 always runs the two exact full searches.
+ *
+ * Batch:
+ *   --batch DIR|MANIFEST solves many mazes in one process, one JSON
+ *   line each; see "Batch".
+ *
+ * Server:
+ *   --serve FILE [--socket PATH] [--cache N] keeps the maze resident
+ *   and answers many start/end queries; see "Resident query server".
+ *
+ * Dynamic:
+ *   --dynamic FILE applies batches of wall toggles from stdin and
+ *   repairs the forward search incrementally; see "Dynamic walls".
+ *
+ * Threads:
+ *   The forward and reverse searches only share the read-only maze, so
+ *   with -j N (N >= 2, default: all cores) they run concurrently, each
+ *   with its own distance buffer and queue, and the combine/tile-count
+ *   loop is split into N row bands (never more bands than rows).  -j 1
+ *   runs everything serially; N above the core count is cut to it, since
+ *   the searches are CPU-bound and extra threads only add contention.
  */
 
-struct Node {
-    long long dist;
-    int r;
-    int c;
-    int d;
+static const uint32_t MOVE_COST = 1;
+static const uint32_t TURN_COST = 1000;
+
+using ReindeerCost = gridsearch::MoveTurnCost<MOVE_COST, TURN_COST>;
+
+struct Maze {
+    int R = 0;               // rows, without the border
+    int C = 0;               // cols, without the border
+    int W = 0;               // padded width, C + 2
+    vector<uint8_t> open;    // (R + 2) * W cells, 1 unless a wall
+    uint32_t start = 0;      // padded cell of S
+    uint32_t end = 0;        // padded cell of E
+    int32_t step[4] = {};    // cell offset of one move in direction d
+
+    size_t cells() const { return open.size(); }
 };
 
-struct NodeCmp {
-    bool operator()(const Node &a, const Node &b) const {
-        return a.dist > b.dist;
+// Check the padded size and fill in the move offsets.
+static void set_steps(Maze &m) {
+    if ((unsigned long long)m.open.size() * 4 > INF) {
+        cerr << "maze too large for 32-bit state ids\n";
+        exit(1);
     }
+    m.step[0] = -m.W;
+    m.step[1] = 1;
+    m.step[2] = m.W;
+    m.step[3] = -1;
+}
+
+// Read the maze into the padded layout, one row at a time.
+// Returns false on empty input; a missing S or E leaves start/end at 0,
+// which is always a border wall.
+static bool read_maze(istream &in, Maze &m) {
+    string line;
+
+    m.R = 0;
+    m.start = m.end = 0;
+    m.open.clear();
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back(); // handle CRLF
+        }
+        if (line.empty()) {
+            continue;
+        }
+        if (m.R == 0) {
+            m.C = (int)line.size();
+            m.W = m.C + 2;
+            m.open.assign(m.W, 0); // top border
+        }
+        int r = m.R++;
+        size_t base = m.open.size();
+        m.open.resize(base + m.W, 0);
+        int n = min((int)line.size(), m.C);
+        for (int c = 0; c < n; ++c) {
+            char ch = line[c];
+            m.open[base + 1 + c] = ch != '#';
+            if (ch == 'S') {
+                m.start = (uint32_t)((r + 1) * m.W + c + 1);
+            } else if (ch == 'E') {
+                m.end = (uint32_t)((r + 1) * m.W + c + 1);
+            }
+        }
+    }
+    if (m.R == 0) {
+        return false;
+    }
+    m.open.resize(m.open.size() + m.W, 0); // bottom border
+    m.open.shrink_to_fit();
+    set_steps(m);
+    return true;
+}
+
+// Expand a converted maze (walls one bit per cell, see lib/aoc_bin.h)
+// into the padded layout: a table lookup expands eight cells at a time,
+// with no text to scan.  The searches keep a byte per cell, so the bits
+// are expanded once here rather than used in place.
+static void expand_maze_bits(const aoc_bin_hdr &h, const uint8_t *data, Maze &m) {
+    static const array<uint64_t, 256> expand = [] {
+        array<uint64_t, 256> t{};
+        for (uint32_t b = 0; b < 256; ++b) {
+            for (uint32_t i = 0; i < 8; ++i) {
+                t[b] |= (uint64_t)((b >> i) & 1) << (8 * i);
+            }
+        }
+        return t;
+    }();
+
+    if ((uint64_t)(h.rows + 2ull) * (h.cols + 2ull) * 4 > INF) {
+        cerr << "maze too large for 32-bit state ids\n";
+        exit(1);
+    }
+    m.R = (int)h.rows;
+    m.C = (int)h.cols;
+    m.W = m.C + 2;
+    m.open.assign((size_t)(m.R + 2) * m.W, 0);
+    for (int r = 0; r < m.R; ++r) {
+        const uint8_t *src = data + (size_t)r * h.stride;
+        uint8_t *dst = &m.open[(size_t)(r + 1) * m.W + 1];
+        int c = 0;
+        for (; c + 8 <= m.C; c += 8) {
+            memcpy(dst + c, &expand[src[c >> 3]], 8);
+        }
+        for (; c < m.C; ++c) {
+            dst[c] = (uint8_t)aoc_bin_bit(src, (size_t)c);
+        }
+    }
+    auto cell = [&](uint64_t rc) {
+        return (uint32_t)((rc / h.cols + 1) * m.W + rc % h.cols + 1);
+    };
+    m.start = cell(h.aux[0]);
+    m.end = cell(h.aux[1]);
+    set_steps(m);
+}
+
+// Read a maze file written by lib/convert.
+static bool read_maze_bin(const char *path, Maze &m) {
+    aoc_bin_map bin;
+
+    if (!aoc_bin_open(&bin, path, AOC_BIN_BITS, 0)) {
+        cerr << path << ": " << bin.err << "\n";
+        return false;
+    }
+    expand_maze_bits(*bin.hdr, bin.data, m);
+    aoc_bin_close(&bin);
+    return true;
+}
+
+// A maze file in either format; converted ones start with the aoc_bin.h
+// magic.
+static bool load_maze(const char *path, Maze &m) {
+    if (aoc_bin_is(path)) {
+        return read_maze_bin(path, m);
+    }
+    ifstream in(path);
+    return in && read_maze(in, m);
+}
+
+// The step-or-turn graph over the padded maze: state p * 4 + d.
+using Moves = gridsearch::HeadingMoves<Maze, gridsearch::PackedHeading, ReindeerCost>;
+
+// Dial's algorithm: all pending distances lie in [cur, cur + TURN_COST],
+// so TURN_COST + 1 circular buckets hold each distance in its own bucket.
+using DialQueue = gridsearch::DialQueue<ReindeerCost>;
+
+template <uint32_t Span>
+using BucketQueue = gridsearch::BucketQueue<Span>;
+
+// Fewest turns from S (East) to E: steps are free and turns cost 1, a
+// 0-1 graph over the same states.  Only --bench runs it, to check
+// ZeroOneQueue against the Dial and heap queues.
+using TurnCost = gridsearch::MoveTurnCost<0, 1>;
+using TurnMoves = gridsearch::HeadingMoves<Maze, gridsearch::PackedHeading, TurnCost>;
+
+template <class Queue>
+uint32_t fewest_turns(const Maze &m) {
+    uint32_t src[] = {m.start * 4 + 1};
+    DistArray dist = gridsearch::search<Dir::forward, Queue>(TurnMoves(m), src);
+    return *min_element(&dist[m.end * 4], &dist[m.end * 4 + 4]);
+}
+
+// Costs are kept in 32 bits; refuse to settle a state whose successors
+// could wrap around.
+static inline void check_cost(uint32_t cost) {
+    gridsearch::check_cost(cost, TURN_COST);
+}
+
+// Dijkstra from a start state (normally S, East) over the forward graph.
+template <class Queue>
+DistArray dijkstra_from_start(const Maze &m, uint32_t start_id) {
+    AocTraceScope trace("forward search");
+    uint32_t src[] = {start_id};
+    return gridsearch::search<Dir::forward, Queue>(Moves(m), src);
+}
+
+// Dijkstra "backwards" from all orientations at an end cell (normally E)
+// over the reversed graph: a step is undone by stepping back, turns are
+// symmetric.
+template <class Queue>
+DistArray dijkstra_reverse_to_end(const Maze &m, uint32_t end) {
+    AocTraceScope trace("reverse search");
+    uint32_t src[] = {end * 4 + 0, end * 4 + 1, end * 4 + 2, end * 4 + 3};
+    return gridsearch::search<Dir::reverse, Queue>(Moves(m), src);
+}
+
+struct Answer {
+    uint32_t best_cost;
+    long long count_tiles;
 };
 
-const int DR[4] = {-1, 0, 1, 0};
-const int DC[4] = {0, 1, 0, -1};
+static uint32_t best_at_end(const Maze &m, const DistArray &dist_start) {
+    uint32_t best_cost = INF;
+    for (uint32_t d = 0; d < 4; ++d) {
+        best_cost = min(best_cost, dist_start[m.end * 4 + d]);
+    }
+    return best_cost;
+}
 
-static const long long INF = numeric_limits<long long>::max();
+// Count open cells in [lo, hi) with some direction on a best path;
+// INF + anything never matches since the sums are taken in 64 bits.
+static long long count_best_tiles(const Maze &m, const DistArray &dist_start,
+                                  const DistArray &dist_end, uint32_t best_cost,
+                                  size_t lo, size_t hi) {
+    AocTraceScope trace("count tiles");
+    long long count_tiles = 0;
+    for (size_t p = lo; p < hi; ++p) {
+        if (!m.open[p]) {
+            continue;
+        }
+        const uint32_t *ds = &dist_start[p * 4];
+        const uint32_t *de = &dist_end[p * 4];
+        for (int d = 0; d < 4; ++d) {
+            if ((uint64_t)ds[d] + de[d] == best_cost) {
+                ++count_tiles;
+                break;
+            }
+        }
+    }
+    return count_tiles;
+}
 
-using DistArray = vector<vector<array<long long, 4>>>;
+// count_best_tiles over the whole maze, split into row bands on jobs
+// threads.
+static long long count_best_tiles_banded(const Maze &m, const DistArray &dist_start,
+                                         const DistArray &dist_end,
+                                         uint32_t best_cost, int jobs) {
+    if (jobs <= 1) {
+        return count_best_tiles(m, dist_start, dist_end, best_cost, 0, m.cells());
+    }
+    size_t rows = m.cells() / m.W;
+    jobs = (int)min<size_t>(jobs, rows);
+    vector<long long> band_tiles(jobs, 0);
+    vector<thread> workers;
+    for (int j = 0; j < jobs; ++j) {
+        size_t lo = rows * j / jobs * m.W;
+        size_t hi = rows * (j + 1) / jobs * m.W;
+        workers.emplace_back([&, j, lo, hi] {
+            aoc_trace_thread_name("tile band");
+            band_tiles[j] = count_best_tiles(m, dist_start, dist_end,
+                                             best_cost, lo, hi);
+        });
+    }
+    long long count_tiles = 0;
+    for (int j = 0; j < jobs; ++j) {
+        workers[j].join();
+        count_tiles += band_tiles[j];
+    }
+    return count_tiles;
+}
 
-// Dijkstra from start (S, East) over the forward graph.
-DistArray dijkstra_from_start(const vector<string> &grid, int sr, int sc) {
-    int R = (int)grid.size();
-    int C = (int)grid[0].size();
+// Run both searches on the given queue type and combine them.
+template <class Queue>
+Answer solve(const Maze &m, int jobs) {
+    DistArray dist_start;
+    DistArray dist_end;
 
-    DistArray dist(
-        R,
-        vector<array<long long, 4>>(C, {INF, INF, INF, INF})
-    );
+    // Part 1: forward Dijkstra; Part 2: backward Dijkstra from E.
+    if (jobs > 1) {
+        thread rev([&] {
+            aoc_trace_thread_name("reverse search");
+            dist_end = dijkstra_reverse_to_end<Queue>(m, m.end);
+        });
+        dist_start = dijkstra_from_start<Queue>(m, m.start * 4 + 1);
+        rev.join();
+    } else {
+        dist_start = dijkstra_from_start<Queue>(m, m.start * 4 + 1);
+    }
 
-    priority_queue<Node, vector<Node>, NodeCmp> pq;
+    uint32_t best_cost = best_at_end(m, dist_start);
+    if (best_cost == INF) {
+        return Answer{INF, 0}; // No path, shouldn't be reached
+    }
 
-    int start_dir = 1; // East
-    dist[sr][sc][start_dir] = 0;
-    pq.push(Node{0LL, sr, sc, start_dir});
+    if (jobs <= 1) {
+        dist_end = dijkstra_reverse_to_end<Queue>(m, m.end);
+    }
+    return Answer{best_cost, count_best_tiles_banded(m, dist_start, dist_end,
+                                                     best_cost, jobs)};
+}
 
-    while (!pq.empty()) {
-        Node cur = pq.top();
-        pq.pop();
+/*
+ * Corridor contraction.
+ *
+ * Most open cells have exactly two open neighbours.  Every other open
+ * cell (junctions, dead ends, S and E) is a key cell; the search runs on
+ * (key, dir) states only, with the turn edges at each key plus one edge
+ * per corridor leaving a key in some direction.  A corridor edge carries
+ * the steps and the bends (one turn each) walked until the next key.
+ *
+ * Turning around inside a corridor is never part of a shortest path, so
+ * the contracted distances at key states equal the grid ones; part 2
+ * re-walks only the corridors whose edge is tight on a best path.
+ */
+struct Corridor {
+    uint32_t to;     // arrival cell
+    uint32_t dir;    // arrival direction
+    uint32_t cost;   // steps + TURN_COST per bend
+};
 
-        long long cost = cur.dist;
-        int r = cur.r;
-        int c = cur.c;
-        int d = cur.d;
+static inline bool is_key(const Maze &m, uint32_t p) {
+    if (p == m.start || p == m.end) {
+        return true;
+    }
+    int deg = m.open[p + m.step[0]] + m.open[p + m.step[1]] +
+              m.open[p + m.step[2]] + m.open[p + m.step[3]];
+    return deg != 2;
+}
 
-        if (cost != dist[r][c][d]) {
-            continue; // stale
+// Walk from key cell p in direction d (whose neighbour is open) to the
+// next key cell, calling visit() on every corridor cell passed.
+template <class Visit>
+static Corridor walk_corridor(const Maze &m, uint32_t p, uint32_t d,
+                              Visit visit) {
+    uint32_t cur = p + m.step[d];
+    uint32_t cost = MOVE_COST;
+
+    while (!is_key(m, cur)) {
+        visit(cur);
+        if (!m.open[cur + m.step[d]]) {
+            // a bend: exactly one of left/right is open
+            uint32_t l = (d + 3) & 3;
+            d = m.open[cur + m.step[l]] ? l : (d + 1) & 3;
+            cost += TURN_COST;
         }
+        cur += m.step[d];
+        cost += MOVE_COST;
+        check_cost(cost);
+    }
+    return Corridor{cur, d, cost};
+}
 
-        // 1) Move forward
-        int nr = r + DR[d];
-        int nc = c + DC[d];
-        if (nr >= 0 && nr < R && nc >= 0 && nc < C) {
-            if (grid[nr][nc] != '#') {
-                long long ncost = cost + 1;
-                if (ncost < dist[nr][nc][d]) {
-                    dist[nr][nc][d] = ncost;
-                    pq.push(Node{ncost, nr, nc, d});
-                }
+struct Edge {
+    uint32_t from;   // key state
+    uint32_t to;     // key state
+    uint32_t cost;
+};
+
+struct JunctionGraph {
+    vector<uint32_t> keys;       // key cells, ascending
+    vector<Edge> edges;          // sorted by from
+    vector<uint32_t> out_off;    // CSR over edges by from state
+    vector<uint32_t> in_off;     // CSR over in_edge by to state
+    vector<uint32_t> in_edge;    // edge indices grouped by to state
+    uint32_t max_cost = TURN_COST;
+
+    size_t states() const { return keys.size() * 4; }
+    uint32_t max_edge() const { return max_cost; }
+
+    // Neighbour generator for gridsearch::search: corridor edges from
+    // their source (forward) or back from their target (reverse), plus
+    // the two symmetric turns.
+    template <Dir D, class F>
+    void each(uint32_t id, F &&f) const {
+        if (D == Dir::forward) {
+            for (uint32_t i = out_off[id]; i < out_off[id + 1]; ++i) {
+                f(edges[i].to, edges[i].cost);
+            }
+        } else {
+            for (uint32_t i = in_off[id]; i < in_off[id + 1]; ++i) {
+                const Edge &e = edges[in_edge[i]];
+                f(e.from, e.cost);
             }
         }
+        f(gridsearch::PackedHeading::left(id), TURN_COST);
+        f(gridsearch::PackedHeading::right(id), TURN_COST);
+    }
 
-        // 2) Rotate left
-        {
-            int nd = (d + 3) % 4;
-            long long ncost = cost + 1000;
-            if (ncost < dist[r][c][nd]) {
-                dist[r][c][nd] = ncost;
-                pq.push(Node{ncost, r, c, nd});
-            }
+    uint32_t key_of(uint32_t cell) const {
+        return (uint32_t)(lower_bound(keys.begin(), keys.end(), cell) - keys.begin());
+    }
+};
+
+static JunctionGraph contract_maze(const Maze &m) {
+    AocTraceScope trace("contract");
+    JunctionGraph g;
+
+    for (uint32_t p = 0; p < m.cells(); ++p) {
+        if (m.open[p] && is_key(m, p)) {
+            g.keys.push_back(p);
         }
+    }
+    if ((unsigned long long)g.keys.size() * 4 > INF) {
+        cerr << "too many junctions for 32-bit state ids\n";
+        exit(1);
+    }
 
-        // 3) Rotate right
-        {
-            int nd = (d + 1) % 4;
-            long long ncost = cost + 1000;
-            if (ncost < dist[r][c][nd]) {
-                dist[r][c][nd] = ncost;
-                pq.push(Node{ncost, r, c, nd});
+    g.out_off.assign(g.states() + 1, 0);
+    for (uint32_t k = 0; k < g.keys.size(); ++k) {
+        uint32_t p = g.keys[k];
+        for (uint32_t d = 0; d < 4; ++d) {
+            g.out_off[k * 4 + d] = (uint32_t)g.edges.size();
+            if (!m.open[p + m.step[d]]) {
+                continue;
             }
+            Corridor w = walk_corridor(m, p, d, [](uint32_t) {});
+            g.edges.push_back(Edge{k * 4 + d, g.key_of(w.to) * 4 + w.dir, w.cost});
+            g.max_cost = max(g.max_cost, w.cost);
         }
     }
+    g.out_off[g.states()] = (uint32_t)g.edges.size();
 
-    return dist;
+    // counting sort of edge indices by destination state
+    g.in_off.assign(g.states() + 1, 0);
+    for (const Edge &e : g.edges) {
+        ++g.in_off[e.to + 1];
+    }
+    for (size_t s = 0; s < g.states(); ++s) {
+        g.in_off[s + 1] += g.in_off[s];
+    }
+    g.in_edge.resize(g.edges.size());
+    vector<uint32_t> fill(g.in_off.begin(), g.in_off.end() - 1);
+    for (uint32_t i = 0; i < g.edges.size(); ++i) {
+        g.in_edge[fill[g.edges[i].to]++] = i;
+    }
+    return g;
 }
 
-// Dijkstra "backwards" from all orientations at E over the reversed graph.
-DistArray dijkstra_reverse_to_end(const vector<string> &grid, int er, int ec) {
-    int R = (int)grid.size();
-    int C = (int)grid[0].size();
+// Solve on the contracted graph, expanding tight corridors for part 2.
+static Answer solve_junction(const Maze &m, const JunctionGraph &g, int jobs) {
+    uint32_t ks = g.key_of(m.start);
+    uint32_t ke = g.key_of(m.end);
+    vector<uint32_t> fwd_src{ks * 4 + 1}; // East
+    vector<uint32_t> rev_src{ke * 4 + 0, ke * 4 + 1, ke * 4 + 2, ke * 4 + 3};
+    DistArray dist_start;
+    DistArray dist_end;
 
-    DistArray dist(
-        R,
-        vector<array<long long, 4>>(C, {INF, INF, INF, INF})
-    );
+    auto forward = [&] {
+        AocTraceScope trace("forward search");
+        dist_start = gridsearch::search<Dir::forward, HeapQueue>(g, fwd_src);
+    };
+    auto reverse = [&] {
+        AocTraceScope trace("reverse search");
+        dist_end = gridsearch::search<Dir::reverse, HeapQueue>(g, rev_src);
+    };
+    if (jobs > 1) {
+        thread rev([&] {
+            aoc_trace_thread_name("reverse search");
+            reverse();
+        });
+        forward();
+        rev.join();
+    } else {
+        forward();
+        reverse();
+    }
+    AocTraceScope trace("expand corridors");
+
+    uint32_t best_cost = INF;
+    for (uint32_t d = 0; d < 4; ++d) {
+        best_cost = min(best_cost, dist_start[ke * 4 + d]);
+    }
+    if (best_cost == INF) {
+        return Answer{INF, 0}; // No path, shouldn't be reached
+    }
 
-    priority_queue<Node, vector<Node>, NodeCmp> pq;
+    vector<bool> on_best(m.cells(), false);
+    long long count_tiles = 0;
+    auto mark = [&](uint32_t p) {
+        if (!on_best[p]) {
+            on_best[p] = true;
+            ++count_tiles;
+        }
+    };
 
-    for (int d = 0; d < 4; ++d) {
-        dist[er][ec][d] = 0;
-        pq.push(Node{0LL, er, ec, d});
+    for (uint32_t k = 0; k < g.keys.size(); ++k) {
+        for (uint32_t d = 0; d < 4; ++d) {
+            if ((uint64_t)dist_start[k * 4 + d] + dist_end[k * 4 + d] == best_cost) {
+                mark(g.keys[k]);
+                break;
+            }
+        }
+    }
+    for (const Edge &e : g.edges) {
+        if ((uint64_t)dist_start[e.from] + e.cost + dist_end[e.to] == best_cost) {
+            walk_corridor(m, g.keys[e.from >> 2], e.from & 3, mark);
+        }
     }
 
-    while (!pq.empty()) {
-        Node cur = pq.top();
-        pq.pop();
+    return Answer{best_cost, count_tiles};
+}
 
-        long long cost = cur.dist;
-        int r = cur.r;
-        int c = cur.c;
-        int d = cur.d;
+/*
+ * A* for part 1.
+ *
+ * Part 1 only needs the cost to E, so it can stop as soon as an E state
+ * is settled.  The heuristic is the Manhattan distance to E plus
+ * TURN_COST for every turn the heading still forces: with the set of
+ * directions the path must move in, facing one of them costs one turn
+ * per remaining direction, facing away costs two.  It never
+ * overestimates, so the first E state popped is optimal.
+ *
+ * The heuristic is also consistent, so f = g + h never decreases along
+ * a search; one edge raises it by at most TURN_COST + 2 * TURN_COST + 2
+ * (a turn, or a step off E that now forces a U-turn), which bounds the
+ * bucket span.
+ */
+using AStarQueue = BucketQueue<3 * TURN_COST + 3>;
+
+static inline uint32_t astar_h(const Maze &m, uint32_t p, uint32_t d,
+                               int er, int ec) {
+    int r = (int)(p / (uint32_t)m.W);
+    int c = (int)(p % (uint32_t)m.W);
+    int dr = er - r;
+    int dc = ec - c;
+    bool need[4] = {dr < 0, dc > 0, dr > 0, dc < 0};
+    int nneed = need[0] + need[1] + need[2] + need[3];
+    int turns;
+
+    if (nneed == 0) {
+        turns = 0;
+    } else if (need[d]) {
+        turns = nneed - 1;
+    } else if (nneed == 2 || need[(d + 2) & 3]) {
+        turns = 2;
+    } else {
+        turns = 1;
+    }
+    return (uint32_t)(abs(dr) + abs(dc)) + TURN_COST * (uint32_t)turns;
+}
+
+// Best cost from state start_id to any orientation at cell end, or INF.
+static uint32_t astar_cost(const Maze &m, uint32_t start_id, uint32_t end) {
+    DistArray dist(m.cells() * 4, INF);
+    AStarQueue pq;
+    Moves moves(m);
+    int er = (int)(end / (uint32_t)m.W);
+    int ec = (int)(end % (uint32_t)m.W);
+
+    auto relax = [&](uint32_t nid, uint32_t ncost) {
+        if (ncost < dist[nid]) {
+            dist[nid] = ncost;
+            pq.push(ncost + astar_h(m, nid >> 2, nid & 3, er, ec), nid);
+        }
+    };
+
+    relax(start_id, 0);
 
-        if (cost != dist[r][c][d]) {
+    Node cur;
+    while (pq.pop(cur)) {
+        uint32_t id = cur.id;
+        uint32_t cost = dist[id];
+        uint32_t p = id >> 2;
+        uint32_t d = id & 3;
+
+        if (cur.dist != cost + astar_h(m, p, d, er, ec)) {
             continue; // stale
         }
+        if (p == end) {
+            return cost;
+        }
+        check_cost(cost);
 
-        // Reversed edges:
+        moves.each<Dir::forward>(id, [&](uint32_t nid, uint32_t w) {
+            relax(nid, cost + w);
+        });
+    }
+    return INF;
+}
 
-        // 1) Reverse of moving forward:
-        //    If in the forward graph, (pr,pc,d) -> (r,c,d) with cost 1,
-        //    then in reverse we have (r,c,d) -> (pr,pc,d) with cost 1.
-        int pr = r - DR[d];
-        int pc = c - DC[d];
-        if (pr >= 0 && pr < R && pc >= 0 && pc < C) {
-            if (grid[pr][pc] != '#') {
-                long long ncost = cost + 1;
-                if (ncost < dist[pr][pc][d]) {
-                    dist[pr][pc][d] = ncost;
-                    pq.push(Node{ncost, pr, pc, d});
-                }
+/*
+ * Resident query server.
+ *
+ * --serve FILE loads and pads the maze once, then answers queries, one
+ * per line, from stdin or (with --socket PATH) from clients of a Unix
+ * domain socket:
+ *
+ *     sr sc sdir er ec [t]
+ *
+ * rows/cols are 0-based, sdir is 0-3 or N/E/S/W.  The reply is the best
+ * cost, followed by the best-path tile count when "t" is given, or
+ * "unreachable" / "error: ...".  A reverse search from an end cell gives
+ * the cost from every start state at once, so those trees are cached
+ * per distinct end cell (LRU, --cache N entries) and a repeated target
+ * costs a single lookup; tile counts add one forward search.
+ */
+struct ReverseCache {
+    struct Entry {
+        uint32_t end;
+        uint64_t used;
+        DistArray dist;
+    };
+
+    size_t cap;
+    uint64_t tick = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    vector<Entry> entries;
+
+    explicit ReverseCache(size_t n) : cap(n) { entries.reserve(n); }
+
+    const DistArray &get(const Maze &m, uint32_t end) {
+        ++tick;
+        for (Entry &e : entries) {
+            if (e.end == end) {
+                e.used = tick;
+                ++hits;
+                return e.dist;
             }
         }
+        ++misses;
+        Entry *e;
+        if (entries.size() < cap) {
+            entries.push_back(Entry{end, tick, {}});
+            e = &entries.back();
+        } else {
+            e = &*min_element(entries.begin(), entries.end(),
+                              [](const Entry &a, const Entry &b) {
+                                  return a.used < b.used;
+                              });
+            e->end = end;
+            e->used = tick;
+            e->dist = DistArray(); // free the evicted tree first
+        }
+        e->dist = dijkstra_reverse_to_end<DialQueue>(m, end);
+        return e->dist;
+    }
+};
 
-        // 2) Reverse of rotations:
-        //    Rotations are symmetric, so from (r,c,d) we can still go to
-        //    (r,c,(d+1)%4) and (r,c,(d+3)%4) with cost 1000.
-        {
-            int nd = (d + 3) % 4;
-            long long ncost = cost + 1000;
-            if (ncost < dist[r][c][nd]) {
-                dist[r][c][nd] = ncost;
-                pq.push(Node{ncost, r, c, nd});
-            }
+static int parse_dir(const char *s) {
+    if (s[0] != '\0' && s[1] == '\0') {
+        switch (s[0]) {
+        case '0': case 'N': case 'n': return 0;
+        case '1': case 'E': case 'e': return 1;
+        case '2': case 'S': case 's': return 2;
+        case '3': case 'W': case 'w': return 3;
         }
-        {
-            int nd = (d + 1) % 4;
-            long long ncost = cost + 1000;
-            if (ncost < dist[r][c][nd]) {
-                dist[r][c][nd] = ncost;
-                pq.push(Node{ncost, r, c, nd});
-            }
+    }
+    return -1;
+}
+
+// A whole token as a decimal int, unlike atoi, which takes "3x" as 3.
+static bool parse_int(const char *s, int &v) {
+    char *end;
+    errno = 0;
+    long x = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || errno == ERANGE || x < INT32_MIN || x > INT32_MAX) {
+        return false;
+    }
+    v = (int)x;
+    return true;
+}
+
+// Answer one query line into out; returns false on a malformed query.
+static bool answer_query(const Maze &m, ReverseCache &cache, char *line,
+                         string &out) {
+    char *tok[7];
+    int n = 0;
+    for (char *t = strtok(line, " \t\r\n"); t && n < 7; t = strtok(nullptr, " \t\r\n")) {
+        tok[n++] = t;
+    }
+    bool want_tiles = n == 6 && strcmp(tok[5], "t") == 0;
+    if (n != 5 && !want_tiles) {
+        out = "error: expected 'sr sc sdir er ec [t]'";
+        return false;
+    }
+
+    int sr, sc, er, ec;
+    if (!parse_int(tok[0], sr) || !parse_int(tok[1], sc) ||
+        !parse_int(tok[3], er) || !parse_int(tok[4], ec)) {
+        out = "error: bad coordinate";
+        return false;
+    }
+    int sd = parse_dir(tok[2]);
+    if (sd < 0) {
+        out = "error: bad direction";
+        return false;
+    }
+    if (sr < 0 || sr >= m.R || sc < 0 || sc >= m.C ||
+        er < 0 || er >= m.R || ec < 0 || ec >= m.C) {
+        out = "error: out of bounds";
+        return false;
+    }
+    uint32_t start = (uint32_t)((sr + 1) * m.W + sc + 1);
+    uint32_t end = (uint32_t)((er + 1) * m.W + ec + 1);
+    if (!m.open[start] || !m.open[end]) {
+        out = "error: wall";
+        return false;
+    }
+
+    uint32_t start_id = start * 4 + (uint32_t)sd;
+    const DistArray &dist_end = cache.get(m, end);
+    uint32_t best_cost = dist_end[start_id];
+    if (best_cost == INF) {
+        out = "unreachable";
+        return true;
+    }
+    out = to_string(best_cost);
+    if (want_tiles) {
+        DistArray dist_start = dijkstra_from_start<DialQueue>(m, start_id);
+        out += ' ';
+        out += to_string(count_best_tiles(m, dist_start, dist_end, best_cost,
+                                          0, m.cells()));
+    }
+    return true;
+}
+
+static void serve_stream(const Maze &m, ReverseCache &cache, FILE *in, FILE *out) {
+    char line[256];
+    string reply;
+    while (fgets(line, sizeof line, in)) {
+        if (line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        answer_query(m, cache, line, reply);
+        // a client that hung up is done, not an error
+        if (fprintf(out, "%s\n", reply.c_str()) < 0 || fflush(out) != 0) {
+            break;
         }
     }
+}
 
-    return dist;
+// Accept clients one at a time on a Unix domain socket at path.  A
+// client closing before it reads its replies must not kill the server,
+// so SIGPIPE is ignored and the failed write ends that client instead.
+static int serve_socket(const Maze &m, ReverseCache &cache, const char *path) {
+    sockaddr_un addr{};
+    if (strlen(path) >= sizeof addr.sun_path) {
+        cerr << "socket path too long\n";
+        return 1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (sockaddr *)&addr, sizeof addr) < 0 || listen(fd, 16) < 0) {
+        perror("bind/listen");
+        close(fd);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    for (;;) {
+        int cfd = accept(fd, nullptr, nullptr);
+        if (cfd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("accept");
+            break;
+        }
+        FILE *in = fdopen(cfd, "r");
+        FILE *out = fdopen(dup(cfd), "w");
+        if (in && out) {
+            serve_stream(m, cache, in, out);
+        }
+        if (in) {
+            fclose(in);
+        } else {
+            close(cfd);
+        }
+        if (out) {
+            fclose(out);
+        }
+    }
+    close(fd);
+    unlink(path);
+    return 1;
 }
 
-int main() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
+/*
+ * Dynamic walls.
+ *
+ * --dynamic FILE keeps the forward distance array of a maze up to date
+ * while walls open and close.  Each stdin line is one batch of toggles,
+ * "r c #" or "r c .", applied at once; the reply is "cost tiles".
+ *
+ * Repair is local (Ramalingam-Reps style):
+ *   - closing: states whose every tight predecessor is gone or itself
+ *     invalidated, visited in increasing old distance, form the
+ *     affected subtree; they are reset to INF;
+ *   - then affected states and the states of opened cells get a
+ *     tentative distance from their surviving predecessors and one
+ *     improvement-only Dijkstra re-propagates from them, which also
+ *     handles every decrease an opened cell causes.
+ * Part 2 walks tight edges back from E over the forward distances, so
+ * it costs the size of the best-path DAG, not of the maze, and needs no
+ * reverse search to be kept alongside.
+ */
+struct DynamicSearch {
+    const Maze *m = nullptr;
+    vector<uint32_t> sources;
+    DistArray dist;
+    vector<uint8_t> mark;         // scratch per state, zero between repairs
+    vector<uint32_t> touched;     // states with a non-zero mark
+
+    enum : uint8_t { CHECKED = 1, AFFECTED = 2 };
 
-    vector<string> grid;
-    {
-        string line;
-        while (getline(cin, line)) {
-            if (!line.empty() && line.back() == '\r') {
-                line.pop_back(); // handle CRLF
+    // cell reached by one step from p in direction d
+    uint32_t ahead(uint32_t p, uint32_t d) const { return p + m->step[d]; }
+
+    bool is_source(uint32_t v) const {
+        return find(sources.begin(), sources.end(), v) != sources.end();
+    }
+
+    void set_mark(uint32_t v, uint8_t f) {
+        if (!mark[v]) {
+            touched.push_back(v);
+        }
+        mark[v] = f;
+    }
+
+    // Call f(u, w) for every predecessor u of open state v.
+    template <class F>
+    void for_preds(uint32_t v, F f) const {
+        Moves(*m).each<Dir::reverse>(v, f);
+    }
+
+    // Call f(s, w) for every successor s of open state v.
+    template <class F>
+    void for_succs(uint32_t v, F f) const {
+        Moves(*m).each<Dir::forward>(v, f);
+    }
+
+    uint32_t tentative(uint32_t v) const {
+        uint32_t best = INF;
+        for_preds(v, [&](uint32_t u, uint32_t w) {
+            if (dist[u] != INF && !(mark[u] & AFFECTED)) {
+                best = min(best, dist[u] + w);
+            }
+        });
+        return best;
+    }
+
+    // Repair dist after the maze changed: closed and opened list cells
+    // whose wall bit flipped (the maze already reflects the change).
+    void repair(const vector<uint32_t> &closed, const vector<uint32_t> &opened) {
+        HeapQueue work;
+
+        // 1) find the affected subtree, in increasing old distance
+        for (uint32_t p : closed) {
+            for (uint32_t d = 0; d < 4; ++d) {
+                uint32_t v = p * 4 + d;
+                if (dist[v] == INF) {
+                    continue;
+                }
+                set_mark(v, AFFECTED);
+                uint32_t q = ahead(p, d);
+                if (m->open[q] && dist[q * 4 + d] == dist[v] + MOVE_COST) {
+                    work.push(dist[q * 4 + d], q * 4 + d);
+                }
+            }
+        }
+        Node cur;
+        while (work.pop(cur)) {
+            uint32_t v = cur.id;
+            if (mark[v]) {
+                continue;
             }
-            if (!line.empty()) {
-                grid.push_back(line);
+            bool supported = is_source(v);
+            for_preds(v, [&](uint32_t u, uint32_t w) {
+                if (dist[u] != INF && !(mark[u] & AFFECTED) &&
+                    dist[u] + w == dist[v]) {
+                    supported = true;
+                }
+            });
+            if (supported) {
+                set_mark(v, CHECKED);
+                continue;
             }
+            set_mark(v, AFFECTED);
+            for_succs(v, [&](uint32_t s, uint32_t w) {
+                if (!mark[s] && dist[s] == dist[v] + w) {
+                    work.push(dist[s], s);
+                }
+            });
+        }
+        for (uint32_t v : touched) {
+            if (mark[v] & AFFECTED) {
+                dist[v] = INF;
+            }
+        }
+
+        // 2) seed tentative distances and re-propagate
+        HeapQueue pq;
+        auto seed = [&](uint32_t v) {
+            uint32_t t = tentative(v);
+            if (t < dist[v]) {
+                dist[v] = t;
+                pq.push(t, v);
+            }
+        };
+        for (uint32_t v : touched) {
+            if ((mark[v] & AFFECTED) && m->open[v >> 2]) {
+                seed(v);
+            }
+        }
+        for (uint32_t p : opened) {
+            for (uint32_t d = 0; d < 4; ++d) {
+                seed(p * 4 + d);
+            }
+        }
+        for (uint32_t v : touched) {
+            mark[v] = 0;
+        }
+        touched.clear();
+
+        while (pq.pop(cur)) {
+            uint32_t v = cur.id;
+            if (cur.dist != dist[v]) {
+                continue; // stale
+            }
+            check_cost(cur.dist);
+            for_succs(v, [&](uint32_t s, uint32_t w) {
+                if (cur.dist + w < dist[s]) {
+                    dist[s] = cur.dist + w;
+                    pq.push(dist[s], s);
+                }
+            });
         }
     }
+};
 
-    if (grid.empty()) {
-        return 0;
+struct DynamicMaze {
+    Maze m;
+    DynamicSearch fwd;
+    vector<uint8_t> seen;         // per cell, for the part 2 walk
+
+    explicit DynamicMaze(Maze maze) : m(std::move(maze)) {
+        fwd.m = &m;
+        fwd.sources = {m.start * 4 + 1};
+        fwd.dist = dijkstra_from_start<DialQueue>(m, m.start * 4 + 1);
+        fwd.mark.assign(fwd.dist.size(), 0);
+        seen.assign(m.cells(), 0);
     }
 
-    int R = (int)grid.size();
-    int C = (int)grid[0].size();
+    // Apply a batch of (cell, wall) toggles and repair the search.
+    // S, E and the border cannot change.
+    void apply(const vector<pair<uint32_t, bool>> &toggles) {
+        vector<uint32_t> closed, opened;
+        for (auto [p, wall] : toggles) {
+            if (p == m.start || p == m.end || m.open[p] == !wall) {
+                continue;
+            }
+            m.open[p] = !wall;
+            (wall ? closed : opened).push_back(p);
+        }
+        // a cell toggled twice in one batch counts by its final state
+        auto settle = [&](vector<uint32_t> &v, uint8_t want) {
+            sort(v.begin(), v.end());
+            v.erase(unique(v.begin(), v.end()), v.end());
+            v.erase(remove_if(v.begin(), v.end(),
+                              [&](uint32_t p) { return m.open[p] != want; }),
+                    v.end());
+        };
+        settle(closed, 0);
+        settle(opened, 1);
+        if (closed.empty() && opened.empty()) {
+            return;
+        }
+        fwd.repair(closed, opened);
+    }
 
-    int sr = -1, sc = -1;
-    int er = -1, ec = -1;
+    Answer answer() {
+        uint32_t best_cost = INF;
+        for (uint32_t d = 0; d < 4; ++d) {
+            best_cost = min(best_cost, fwd.dist[m.end * 4 + d]);
+        }
+        if (best_cost == INF) {
+            return Answer{INF, 0};
+        }
 
-    // Find S and E
-    for (int r = 0; r < R; ++r) {
-        for (int c = 0; c < C; ++c) {
-            if (grid[r][c] == 'S') {
-                sr = r;
-                sc = c;
-            } else if (grid[r][c] == 'E') {
-                er = r;
-                ec = c;
+        // walk tight forward edges back from the optimal E states
+        vector<uint32_t> stack, cells;
+        for (uint32_t d = 0; d < 4; ++d) {
+            if (fwd.dist[m.end * 4 + d] == best_cost) {
+                fwd.set_mark(m.end * 4 + d, DynamicSearch::CHECKED);
+                stack.push_back(m.end * 4 + d);
+            }
+        }
+        while (!stack.empty()) {
+            uint32_t v = stack.back();
+            stack.pop_back();
+            if (!seen[v >> 2]) {
+                seen[v >> 2] = 1;
+                cells.push_back(v >> 2);
             }
+            fwd.for_preds(v, [&](uint32_t u, uint32_t w) {
+                if (!fwd.mark[u] && fwd.dist[u] != INF &&
+                    fwd.dist[u] + w == fwd.dist[v]) {
+                    fwd.set_mark(u, DynamicSearch::CHECKED);
+                    stack.push_back(u);
+                }
+            });
+        }
+        for (uint32_t v : fwd.touched) {
+            fwd.mark[v] = 0;
         }
+        fwd.touched.clear();
+        for (uint32_t p : cells) {
+            seen[p] = 0;
+        }
+        return Answer{best_cost, (long long)cells.size()};
     }
+};
 
-    if (sr < 0 || sc < 0 || er < 0 || ec < 0) {
-        return 0; // invalid input
+static void print_answer(FILE *out, const Answer &ans) {
+    if (ans.best_cost == INF) {
+        fprintf(out, "unreachable\n");
+    } else {
+        fprintf(out, "%u %lld\n", ans.best_cost, ans.count_tiles);
+    }
+    fflush(out);
+}
+
+// Read toggle batches, one per line, and print the answers after each.
+static void serve_dynamic(DynamicMaze &dm, FILE *in, FILE *out) {
+    char line[4096];
+    print_answer(out, dm.answer());
+    while (fgets(line, sizeof line, in)) {
+        vector<pair<uint32_t, bool>> toggles;
+        bool ok = true;
+        char *save = nullptr;
+        for (char *t = strtok_r(line, " \t\r\n", &save); t;
+             t = strtok_r(nullptr, " \t\r\n", &save)) {
+            char *tc = strtok_r(nullptr, " \t\r\n", &save);
+            char *tw = strtok_r(nullptr, " \t\r\n", &save);
+            int r, c;
+            if (!tc || !tw || !parse_int(t, r) || !parse_int(tc, c) ||
+                (strcmp(tw, "#") != 0 && strcmp(tw, ".") != 0) ||
+                r < 0 || r >= dm.m.R || c < 0 || c >= dm.m.C) {
+                ok = false;
+                break;
+            }
+            toggles.emplace_back((uint32_t)((r + 1) * dm.m.W + c + 1), tw[0] == '#');
+        }
+        if (!ok) {
+            fprintf(out, "error: expected 'r c #|.' triples\n");
+            fflush(out);
+            continue;
+        }
+        dm.apply(toggles);
+        print_answer(out, dm.answer());
     }
+}
+
+/*
+ * Parallel delta-stepping.
+ *
+ * With DELTA = TURN_COST, steps (cost 1) are light edges and turns
+ * (cost 1000) are heavy ones, so a state in bucket i = dist / DELTA
+ * only ever sends work to buckets i and i + 1.
+ *
+ * Maze frontiers are thin, so one global round per distance level would
+ * be all barrier and no work.  Instead each worker takes a slice of the
+ * bucket's frontier and settles it with its own local Dial over the
+ * DELTA distances of the bucket, relaxing light edges with an atomic
+ * min on dist and re-processing whatever it improves.  A state improved
+ * by another worker is simply processed again by that worker, so when
+ * every worker runs dry the bucket is final.  After one barrier each
+ * worker relaxes the heavy turn edges of the states it settled, and the
+ * bucket i + 1 lists are regathered and re-sliced for the next bucket.
+ * Final distances are unique, so the result is the same array the
+ * sequential searches produce, whatever the interleaving.
+ */
+static const uint32_t DELTA = TURN_COST;
 
-    // Part 1: forward Dijkstra
-    DistArray dist_start = dijkstra_from_start(grid, sr, sc);
+static inline uint32_t atomic_load_dist(DistArray &dist, uint32_t v) {
+    return atomic_ref<uint32_t>(dist[v]).load(memory_order_relaxed);
+}
 
-    long long best_cost = INF;
-    for (int d = 0; d < 4; ++d) {
-        if (dist_start[er][ec][d] < best_cost) {
-            best_cost = dist_start[er][ec][d];
+static inline bool atomic_min_dist(DistArray &dist, uint32_t v, uint32_t nd) {
+    atomic_ref<uint32_t> a(dist[v]);
+    uint32_t old = a.load(memory_order_relaxed);
+    while (nd < old) {
+        if (a.compare_exchange_weak(old, nd, memory_order_relaxed)) {
+            return true;
         }
     }
+    return false;
+}
 
-    if (best_cost == INF) {
-        return 0; // No path, shouldn't be reached
+// Delta-stepping over the grid states on nthreads threads (sgn = +1 for
+// the forward search, -1 for the reverse one).
+static DistArray delta_stepping(const Maze &m, int sgn,
+                                const vector<uint32_t> &sources, int nthreads) {
+    DistArray dist(m.cells() * 4, INF);
+    vector<uint32_t> frontier(sources);
+    vector<vector<uint32_t>> next(nthreads);   // per worker, for bucket + 1
+    barrier sync(nthreads);
+    uint32_t bucket = 0;
+    bool done = frontier.empty();
+
+    for (uint32_t s : sources) {
+        dist[s] = 0;
     }
 
-    // Part 2: backward Dijkstra from E
-    DistArray dist_end = dijkstra_reverse_to_end(grid, er, ec);
+    auto worker = [&](int t) {
+        vector<vector<uint32_t>> local(DELTA);   // dist - base -> states
+        vector<uint32_t> settled;
 
-    // Mark tiles that are on some optimal path
-    vector<vector<bool>> on_best_path(R, vector<bool>(C, false));
+        if (t > 0) {
+            aoc_trace_thread_name("delta worker");
+        }
+        while (!done) {
+            uint32_t base = bucket * DELTA;
+            uint64_t tr = aoc_trace_begin();
 
-    for (int r = 0; r < R; ++r) {
-        for (int c = 0; c < C; ++c) {
-            if (grid[r][c] == '#') {
-                continue;
+            // light edges: settle my slice and everything it improves
+            size_t n = frontier.size();
+            for (size_t i = n * t / nthreads; i < n * (t + 1) / nthreads; ++i) {
+                uint32_t v = frontier[i];
+                uint32_t dv = atomic_load_dist(dist, v);
+                if (dv / DELTA == bucket) {
+                    local[dv - base].push_back(v);
+                }
             }
-            bool ok = false;
-            for (int d = 0; d < 4; ++d) {
-                long long ds = dist_start[r][c][d];
-                long long de = dist_end[r][c][d];
-                if (ds == INF || de == INF) {
-                    continue;
+            for (uint32_t k = 0; k < DELTA; ++k) {
+                for (size_t i = 0; i < local[k].size(); ++i) {
+                    uint32_t v = local[k][i];
+                    if (atomic_load_dist(dist, v) != base + k) {
+                        continue; // stale
+                    }
+                    settled.push_back(v);
+                    uint32_t p = v >> 2, d = v & 3;
+                    uint32_t q = p + sgn * m.step[d];
+                    if (!m.open[q]) {
+                        continue;
+                    }
+                    uint32_t nv = q * 4 + d;
+                    uint32_t nd = base + k + MOVE_COST;
+                    if (atomic_min_dist(dist, nv, nd)) {
+                        if (k + MOVE_COST < DELTA) {
+                            local[k + MOVE_COST].push_back(nv);
+                        } else {
+                            next[t].push_back(nv);
+                        }
+                    }
+                }
+                local[k].clear();
+            }
+            aoc_trace_end("light edges", tr);
+            sync.arrive_and_wait();
+
+            // heavy edges of everything settled in this bucket
+            tr = aoc_trace_begin();
+            for (uint32_t v : settled) {
+                uint32_t dv = atomic_load_dist(dist, v);
+                check_cost(dv);
+                uint32_t k4 = v & ~3u, d = v & 3;
+                uint32_t l = k4 + ((d + 3) & 3), r = k4 + ((d + 1) & 3);
+                if (atomic_min_dist(dist, l, dv + TURN_COST)) {
+                    next[t].push_back(l);
                 }
-                if (ds + de == best_cost) {
-                    ok = true;
-                    break;
+                if (atomic_min_dist(dist, r, dv + TURN_COST)) {
+                    next[t].push_back(r);
                 }
             }
-            if (ok) {
-                on_best_path[r][c] = true;
+            settled.clear();
+            aoc_trace_end("heavy edges", tr);
+            sync.arrive_and_wait();
+
+            // regather bucket + 1 at per-worker offsets
+            size_t off = 0, total = 0;
+            for (int u = 0; u < nthreads; ++u) {
+                if (u == t) {
+                    off = total;
+                }
+                total += next[u].size();
+            }
+            if (t == 0) {
+                frontier.resize(total);
             }
+            sync.arrive_and_wait();
+            copy(next[t].begin(), next[t].end(), frontier.begin() + off);
+            sync.arrive_and_wait();
+            next[t].clear();
+            if (t == 0) {
+                ++bucket;
+                done = frontier.empty();
+            }
+            sync.arrive_and_wait();
         }
+    };
+
+    vector<thread> pool;
+    for (int t = 1; t < nthreads; ++t) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+    for (thread &th : pool) {
+        th.join();
     }
+    return dist;
+}
 
-    long long count_tiles = 0;
-    for (int r = 0; r < R; ++r) {
-        for (int c = 0; c < C; ++c) {
-            if (on_best_path[r][c]) {
-                ++count_tiles;
+// Both searches with delta-stepping, each on all nthreads threads.
+static Answer solve_delta(const Maze &m, int nthreads) {
+    vector<uint32_t> fwd_src{m.start * 4 + 1};
+    vector<uint32_t> rev_src{m.end * 4 + 0, m.end * 4 + 1, m.end * 4 + 2, m.end * 4 + 3};
+    DistArray dist_start = delta_stepping(m, 1, fwd_src, nthreads);
+    uint32_t best_cost = best_at_end(m, dist_start);
+    if (best_cost == INF) {
+        return Answer{INF, 0};
+    }
+    DistArray dist_end = delta_stepping(m, -1, rev_src, nthreads);
+    return Answer{best_cost, count_best_tiles_banded(m, dist_start, dist_end,
+                                                     best_cost, nthreads)};
+}
+
+// Counters for --perf; null when not asked for.
+static aoc_perf *perf_counters = nullptr;
+
+// Best of n runs of run(), in milliseconds; with --perf, *s gets the
+// counters of that best run.  run() returns nothing; the overload below
+// keeps the Answer of solvers that return one.
+template <class Run>
+double bench(int n, Run run, aoc_perf_sample *s = nullptr) {
+    double best_ms = numeric_limits<double>::max();
+    for (int i = 0; i < n; ++i) {
+        aoc_perf_sample cur;
+        if (perf_counters && s) {
+            aoc_perf_start(perf_counters);
+        }
+        auto t0 = chrono::steady_clock::now();
+        run();
+        auto t1 = chrono::steady_clock::now();
+        if (perf_counters && s) {
+            aoc_perf_stop(perf_counters, &cur);
+        }
+        double ms = chrono::duration<double, milli>(t1 - t0).count();
+        if (ms < best_ms) {
+            best_ms = ms;
+            if (perf_counters && s) {
+                *s = cur;
             }
         }
     }
+    return best_ms;
+}
+
+template <class Run>
+double bench(int n, Answer &ans, Run run, aoc_perf_sample *s = nullptr) {
+    return bench(n, [&] { ans = run(); }, s);
+}
+
+// Part 1 and 2 with the engine selected on the command line.
+static Answer solve_maze(const Maze &maze, const string &graph, const string &queue,
+                         int jobs) {
+    if (graph == "junction") {
+        JunctionGraph g = contract_maze(maze);
+        return solve_junction(maze, g, jobs);
+    } else if (queue == "delta") {
+        return solve_delta(maze, jobs);
+    } else if (queue == "heap") {
+        return solve<HeapQueue>(maze, jobs);
+    } else if (queue == "iheap") {
+        return solve<IndexedHeap>(maze, jobs);
+    }
+    return solve<DialQueue>(maze, jobs);
+}
+
+/*
+ * Batch
+ *
+ * --batch DIR|MANIFEST solves every maze in a directory (sorted by
+ * name) or listed one path per line in a manifest, text or converted,
+ * and prints one JSON record per maze on stdout:
+ *
+ *   {"file":"a.txt","part1":7036,"part2":45,"ms":0.21}
+ *   {"file":"b.txt","error":"no S or E"}
+ *
+ * then files/s on stderr.  lib/aoc_batch.h parses the next maze on a
+ * thread of its own while this one is solved, and reads the ones after
+ * it (via io_uring where there is one).
+ */
 
-    cout << "Part 1: " << best_cost << "\n";
-    cout << "Part 2: " << count_tiles << "\n";
+// A read-only istream source over a batch buffer, so read_maze parses it
+// where it was read.
+struct MemBuf : streambuf {
+    MemBuf(char *p, size_t n) { setg(p, p, p + n); }
+};
+
+// One batch maze made ready to solve, by parse_batch_file on the parse
+// stage's thread (lib/aoc_batch.h).
+struct MazeJob {
+    Maze maze;
+    const char *err = nullptr;
+};
+
+static void *parse_batch_file(aoc_batch_file *f, void *) {
+    auto *j = new (nothrow) MazeJob;
+
+    if (!j) {
+        return nullptr;
+    }
+    if (f->err) {
+        j->err = strerror(f->err);
+    } else if (f->n >= 4 && memcmp(f->p, AOC_BIN_MAGIC, 4) == 0) {
+        j->err = aoc_bin_check(f->p, f->n, AOC_BIN_BITS, 0);
+        if (!j->err) {
+            AocTraceScope trace("read");
+            expand_maze_bits(*(const aoc_bin_hdr *)f->p,
+                             (const uint8_t *)f->p + sizeof(aoc_bin_hdr), j->maze);
+        }
+    } else {
+        AocTraceScope trace("read");
+        MemBuf mb(f->p, f->n);
+        istream in(&mb);
+        if (!read_maze(in, j->maze)) {
+            j->err = "empty input";
+        }
+    }
+    if (!j->err && (!j->maze.start || !j->maze.end)) {
+        j->err = "no S or E";
+    }
+    return j;
+}
 
+static void drop_batch_job(void *parsed, void *) {
+    delete static_cast<MazeJob *>(parsed);
+}
+
+static int run_batch(const char *src, const string &graph, const string &queue,
+                     int part, int jobs) {
+    aoc_batch b;
+    aoc_batch_file f;
+
+    if (!aoc_batch_open(&b, src)) {
+        cerr << src << ": cannot list inputs\n";
+        return 1;
+    }
+    (void)aoc_batch_parse(&b, parse_batch_file, drop_batch_job, nullptr); // else in line
+    while (aoc_batch_next(&b, &f)) {
+        auto *job = static_cast<MazeJob *>(f.parsed);
+        double t0 = aoc_perf_ms();
+        const char *err = job ? job->err : "out of memory";
+
+        printf("{\"file\":");
+        aoc_json_str(stdout, f.path);
+
+        Answer ans{INF, 0};
+        if (!err && part == 1) {
+            AocTraceScope trace("part 1");
+            ans.best_cost = astar_cost(job->maze, job->maze.start * 4 + 1, job->maze.end);
+        } else if (!err) {
+            AocTraceScope trace("parts 1+2");
+            ans = solve_maze(job->maze, graph, queue, jobs);
+        }
+        if (!err && ans.best_cost == INF) {
+            err = "no path";
+        }
+        drop_batch_job(job, nullptr);
+        free(f.p);
+
+        if (err) {
+            printf(",\"error\":");
+            aoc_json_str(stdout, err);
+            printf("}\n");
+            continue;
+        }
+        printf(",\"part1\":%u", ans.best_cost);
+        if (part == 2) {
+            printf(",\"part2\":%lld", ans.count_tiles);
+        }
+        printf(",\"ms\":%.3f}\n", aoc_perf_ms() - t0);
+    }
+    fflush(stdout);
+    aoc_batch_report(&b, stderr);
+    aoc_batch_close(&b);
     return 0;
 }
 
+static void open_counters(aoc_perf &pc) {
+    char why[96];
+    // solver threads are created later, so inherit covers them
+    if (aoc_perf_open(&pc, AOC_PERF_INHERIT) == 0) {
+        cerr << "(no counters: " << aoc_perf_why(&pc, why, sizeof why) << ")\n";
+    }
+    perf_counters = &pc;
+}
+
+static void usage(const char *argv0) {
+    cerr << "usage: " << argv0
+         << " [--graph grid|junction] [--queue heap|iheap|dial|delta] [--part 1|2]"
+            " [-j N] [--bench N] [--perf] [--input FILE | < input]\n"
+         << "       " << argv0 << " [--graph ...] [--queue ...] [--part 1|2] [-j N]"
+            " --batch DIR|MANIFEST\n"
+         << "       " << argv0 << " --scale N < input\n"
+         << "       " << argv0
+         << " --serve FILE [--socket PATH] [--cache N] < queries\n"
+         << "       " << argv0 << " --dynamic FILE < toggles\n";
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    string graph = "junction";
+    int part = 2;
+    const char *serve_file = nullptr;
+    const char *socket_path = nullptr;
+    const char *dynamic_file = nullptr;
+    const char *input_file = nullptr;
+    const char *batch_src = nullptr;
+    long cache_size = 8;
+    string queue = "dial";
+    bool graph_given = false;
+    int bench_runs = 0;
+    int scale_max = 0;
+    bool perf = false;
+    const int cores = max(1, (int)thread::hardware_concurrency());
+    int jobs = cores;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--graph") == 0 && i + 1 < argc) {
+            graph = argv[++i];
+            graph_given = true;
+        } else if (strcmp(argv[i], "--part") == 0 && i + 1 < argc) {
+            part = atoi(argv[++i]);
+            if (part != 1 && part != 2) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_file = argv[++i];
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input_file = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_src = argv[++i];
+        } else if (strcmp(argv[i], "--dynamic") == 0 && i + 1 < argc) {
+            dynamic_file = argv[++i];
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_size = atol(argv[++i]);
+            if (cache_size <= 0) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+            queue = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+            if (jobs <= 0) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale_max = atoi(argv[++i]);
+            if (scale_max <= 0) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            perf = true;
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_runs = atoi(argv[++i]);
+            if (bench_runs <= 0) {
+                usage(argv[0]);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+    jobs = min(jobs, cores);
+    if ((graph != "grid" && graph != "junction") ||
+        (queue != "heap" && queue != "iheap" && queue != "dial" && queue != "delta")) {
+        usage(argv[0]);
+    }
+    if (queue == "delta" && !graph_given) {
+        graph = "grid"; // delta-stepping runs on the grid states
+    }
+
+    if (batch_src) {
+        return run_batch(batch_src, graph, queue, part, jobs);
+    }
+
+    Maze maze;
+    if (serve_file) {
+        if (!load_maze(serve_file, maze)) {
+            cerr << "cannot read maze " << serve_file << "\n";
+            return 1;
+        }
+        ReverseCache cache((size_t)cache_size);
+        if (socket_path) {
+            return serve_socket(maze, cache, socket_path);
+        }
+        serve_stream(maze, cache, stdin, stdout);
+        return 0;
+    }
+
+    if (dynamic_file) {
+        if (!load_maze(dynamic_file, maze) || !maze.start || !maze.end) {
+            cerr << "cannot read maze " << dynamic_file << "\n";
+            return 1;
+        }
+        DynamicMaze dm(std::move(maze));
+        serve_dynamic(dm, stdin, stdout);
+        return 0;
+    }
+
+    aoc_perf pc;
+    aoc_perf_sample read_s, solve_s;
+    if (perf) {
+        open_counters(pc);
+        aoc_perf_start(&pc);
+    }
+    double t0 = aoc_perf_ms();
+    uint64_t tr = aoc_trace_begin();
+    bool ok = input_file ? load_maze(input_file, maze) : read_maze(cin, maze);
+    aoc_trace_end("read", tr);
+    double read_ms = aoc_perf_ms() - t0;
+    if (perf) {
+        aoc_perf_stop(&pc, &read_s);
+    }
+    if (!ok || !maze.start || !maze.end) {
+        return 0; // invalid input
+    }
+
+    if (scale_max > 0) {
+        // delta-stepping on 1, 2, 4, ... scale_max threads vs. serial Dial
+        Answer ref, ans;
+        double dial_ms = bench(1, ref, [&] { return solve<DialQueue>(maze, 1); });
+        cerr << maze.R << "x" << maze.C << " delta-stepping scaling:\n";
+        cerr << "  dial -j 1: " << dial_ms << " ms\n";
+        for (int t = 1;; t = min(2 * t, scale_max)) {
+            double ms = bench(1, ans, [&] { return solve_delta(maze, t); });
+            cerr << "  delta -j " << t << ": " << ms << " ms ("
+                 << dial_ms / ms << "x vs dial)\n";
+            if (ans.best_cost != ref.best_cost || ans.count_tiles != ref.count_tiles) {
+                cerr << "engines disagree\n";
+                return 1;
+            }
+            if (t == scale_max) {
+                break;
+            }
+        }
+        return 0;
+    }
+
+    if (bench_runs > 0) {
+        Answer heap_ans, iheap_ans, dial_ans, junction_ans;
+        aoc_perf_sample heap_s, iheap_s, dial_s, junction_s, astar_s, full_s;
+        JunctionGraph g;
+        double heap_ms = bench(bench_runs, heap_ans,
+                               [&] { return solve<HeapQueue>(maze, jobs); }, &heap_s);
+        double iheap_ms = bench(bench_runs, iheap_ans,
+                                [&] { return solve<IndexedHeap>(maze, jobs); }, &iheap_s);
+        double dial_ms = bench(bench_runs, dial_ans,
+                               [&] { return solve<DialQueue>(maze, jobs); }, &dial_s);
+        double junction_ms = bench(bench_runs, junction_ans, [&] {
+            g = contract_maze(maze);
+            return solve_junction(maze, g, jobs);
+        }, &junction_s);
+        uint32_t astar_ans = INF, full_ans = INF;
+        double astar_ms = bench(bench_runs, [&] {
+            astar_ans = astar_cost(maze, maze.start * 4 + 1, maze.end);
+        }, &astar_s);
+        double full_ms = bench(bench_runs, [&] {
+            DistArray dist = dijkstra_from_start<DialQueue>(maze, maze.start * 4 + 1);
+            full_ans = *min_element(&dist[maze.end * 4], &dist[maze.end * 4 + 4]);
+        }, &full_s);
+        uint32_t turns_heap = INF, turns_dial = INF, turns_01 = INF;
+        double turns_heap_ms = bench(bench_runs, [&] {
+            turns_heap = fewest_turns<HeapQueue>(maze);
+        });
+        double turns_dial_ms = bench(bench_runs, [&] {
+            turns_dial = fewest_turns<gridsearch::DialQueue<TurnCost>>(maze);
+        });
+        double turns_01_ms = bench(bench_runs, [&] {
+            turns_01 = fewest_turns<gridsearch::ZeroOneQueue>(maze);
+        });
+        size_t open_cells = count(maze.open.begin(), maze.open.end(), 1);
+        cerr << maze.R << "x" << maze.C << " -j " << jobs
+             << " best of " << bench_runs << ":\n";
+        cerr << "  heap:     " << heap_ms << " ms\n";
+        cerr << "  iheap:    " << iheap_ms << " ms (" << heap_ms / iheap_ms << "x)\n";
+        cerr << "  dial:     " << dial_ms << " ms (" << heap_ms / dial_ms << "x)\n";
+        cerr << "  junction: " << junction_ms << " ms ("
+             << heap_ms / junction_ms << "x), states "
+             << open_cells * 4 << " -> " << g.states() << " ("
+             << (double)open_cells * 4 / g.states() << "x fewer)\n";
+        cerr << "  part 1 full dial: " << full_ms << " ms\n";
+        cerr << "  part 1 A*:        " << astar_ms << " ms ("
+             << full_ms / astar_ms << "x)\n";
+        cerr << "  fewest turns (" << turns_01 << ", 0-1 costs): heap " << turns_heap_ms
+             << " ms, dial " << turns_dial_ms << " ms, 0-1 deque "
+             << turns_01_ms << " ms\n";
+        if (perf) {
+            cerr << "counters, best run:\n";
+            aoc_perf_report(stderr, "heap", heap_ms, &heap_s);
+            aoc_perf_report(stderr, "iheap", iheap_ms, &iheap_s);
+            aoc_perf_report(stderr, "dial", dial_ms, &dial_s);
+            aoc_perf_report(stderr, "junction", junction_ms, &junction_s);
+            aoc_perf_report(stderr, "full dial", full_ms, &full_s);
+            aoc_perf_report(stderr, "A*", astar_ms, &astar_s);
+        }
+        if (heap_ans.best_cost != dial_ans.best_cost ||
+            heap_ans.count_tiles != dial_ans.count_tiles ||
+            heap_ans.best_cost != iheap_ans.best_cost ||
+            heap_ans.count_tiles != iheap_ans.count_tiles ||
+            heap_ans.best_cost != junction_ans.best_cost ||
+            heap_ans.count_tiles != junction_ans.count_tiles ||
+            heap_ans.best_cost != astar_ans || full_ans != astar_ans ||
+            turns_heap != turns_dial || turns_heap != turns_01) {
+            cerr << "engines disagree\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    // read and solve phases, after the answers so stdout stays clean
+    auto report_phases = [&](double solve_ms) {
+        if (perf) {
+            cout.flush();
+            aoc_perf_report(stderr, "read", read_ms, &read_s);
+            aoc_perf_report(stderr, "solve", solve_ms, &solve_s);
+            aoc_perf_close(&pc);
+        }
+    };
+
+    if (part == 1) {
+        uint32_t best_cost = INF;
+        double solve_ms = bench(1, [&] {
+            AocTraceScope trace("part 1");
+            best_cost = astar_cost(maze, maze.start * 4 + 1, maze.end);
+        }, &solve_s);
+        if (best_cost != INF) {
+            cout << "Part 1: " << best_cost << "\n";
+        }
+        report_phases(solve_ms);
+        return 0;
+    }
+
+    Answer ans;
+    double solve_ms = bench(1, ans, [&] {
+        AocTraceScope trace("parts 1+2");
+        return solve_maze(maze, graph, queue, jobs);
+    }, &solve_s);
+
+    if (ans.best_cost == INF) {
+        return 0; // No path, shouldn't be reached
+    }
+
+    cout << "Part 1: " << ans.best_cost << "\n";
+    cout << "Part 2: " << ans.count_tiles << "\n";
+    report_phases(solve_ms);
+
+    return 0;
+}
@@ -1,3 +1,5 @@
+#define _GNU_SOURCE // MAP_ANONYMOUS, MAP_POPULATE for aoc_vmem.h
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,58 +7,39 @@
 #include <stdalign.h>
 #include <sys/types.h>
 
-#define ARENA_INIT_SIZE 1024
+#include "aoc_vmem.h"
+
+// Reserve plenty of address space up front; only what is used gets
+// committed, and the buffer never moves, so pointers stay valid.
+#define ARENA_RESERVE ((size_t)1 << 30)
 
 typedef struct {
-	char *buf;
-	size_t sz;
-	size_t offset;
+	struct aoc_vm_arena vm;
 } Arena;
 
-Arena
+bool
 arena_init(Arena *a)
 {
-	a->buf = (char *)malloc(ARENA_INIT_SIZE);
-	if (!a->buf) { return NULL; }
-	a->sz = ARENA_INIT_SIZE;
-	a->offset = 0;
-	return a;
+	return aoc_vm_init(&a->vm, ARENA_RESERVE, 0);
 }
 
 void *
 arena_alloc(Arena *a, size_t sz, size_t alignment)
 {
-	size_t aligned_offset = (a->offset + (alignment - 1)) & ~(alignment - 1);
-	if (aligned_offset + sz > a->sz) {
-		size_t new_sz = a->sz * 2;
-		while (aligned_offset + sz > new_sz) {
-			new_sz *= 2;
-		}
-		char *new_buf = realloc(a->buf, new_sz);
-		if (!new_buf) { return NULL; } // allocation failed
-		a->buf = new_buf;
-		a->sz = new_sz;
-	}
-
-	void *ptr = (void *)(a->buf + aligned_offset);
-	a->offset = aligned_offset + sz;
-	return ptr;
+	return aoc_vm_alloc_align(&a->vm, sz, alignment);
 }
 
 
 void
 arena_reset(Arena *a)
 {
-	a->offset = 0;
+	aoc_vm_reset(&a->vm);
 }
 
 void
 arena_free(Arena *a)
 {
-	free(a->buf);
-	a->buf = NULL;
-	a->sz = 0;
-	a->offset = 0;
+	aoc_vm_free(&a->vm);
 }
 
 ssize_t getline(char **restrict lineptr, size_t *restrict n,
@@ -1,4 +1,5 @@
 #include "arena.c"
+#include "aoc_trace.h"
 
 typedef enum {
 	UP = 0,
@@ -30,11 +31,12 @@ parse_map(const char *fn, Guard *g, Arena *a)
 
 	char **lines = NULL;
 	size_t cap = 0;
+	size_t nlines = 16;
 	ssize_t len;
 	size_t rows = 0;
 	size_t cols = 0;
 
-	lines = arena_alloc(a, sizeof(char*) * 1, alignof(char*));
+	lines = arena_alloc(a, sizeof(char*) * nlines, alignof(char*));
 	if (!lines) {
 		fprintf(stderr, "failed to alloc memory for lines.\n");
 		fclose(f);
@@ -57,16 +59,22 @@ parse_map(const char *fn, Guard *g, Arena *a)
 		}
 
 		rows++;
-		char **temp = arena_alloc(a, sizeof(char*) * (rows+1), alignof(char*));
-		if (!temp) {
-			fprintf(stderr, "failed to alloc memory for lines.\n");
-			fclose(f);
-			exit(EXIT_FAILURE);
+		if (rows == nlines) {
+			// double the table, so copying it stays linear in rows
+			char **temp = arena_alloc(a, sizeof(char*) * nlines * 2, alignof(char*));
+			if (!temp) {
+				fprintf(stderr, "failed to alloc memory for lines.\n");
+				fclose(f);
+				exit(EXIT_FAILURE);
+			}
+			memcpy(temp, lines, sizeof(char*) * rows);
+			lines = temp;
+			nlines *= 2;
 		}
-		memcpy(temp, lines, sizeof(char*) * rows);
-		temp[rows] = NULL;
-		lines = temp;
+		lines[rows] = NULL;
+		cap = 0;
 	}
+	free(lines[rows]);
 	fclose(f);
 
 	char **grid = arena_alloc(a, sizeof(char*) * rows, alignof(char*));
@@ -82,6 +90,7 @@ parse_map(const char *fn, Guard *g, Arena *a)
 			exit(EXIT_FAILURE);
 		}
 		strcpy(grid[i], lines[i]);
+		free(lines[i]);
 	}
 	Map m;
 	m.grid = grid;
@@ -137,7 +146,7 @@ within_map(Map m, int x, int y)
 }
 
 int
-part_1(Map m, Guard *g, bool **visited_set, Arena *a)
+part_1(Map m, Guard *g, bool **visited_set)
 {
 	int visits = 0;
 	visited_set[g->y][g->x] = true;
@@ -187,42 +196,351 @@ cleanup:
 	return visits;
 }
 
+/*
+ * Sparse mode (-s), for maps far larger than their obstacle count.
+ *
+ * The obstacles are kept twice, sorted: row_x[row_start[y] ..
+ * row_start[y+1]) are the columns of the obstacles in row y, col_y the
+ * same by column.  The guard then walks a whole segment at a time, the
+ * next obstacle ahead being one binary search away, and each segment is
+ * recorded as a run of cells.  Runs along a row or a column are merged
+ * into disjoint intervals; the distinct cells are the cells of both sets
+ * less the cells where a row interval crosses a column interval, which
+ * a sweep down the rows counts.  Memory is the obstacles, the segments
+ * and two counters per row and column; the map itself is never stored.
+ */
+
+typedef struct {
+	int rows;
+	int cols;
+	int n;          // obstacles
+	int *row_start; // rows+1 offsets into row_x
+	int *row_x;     // obstacle columns, ascending within a row
+	int *col_start; // cols+1 offsets into col_y
+	int *col_y;     // obstacle rows, ascending within a column
+} SparseMap;
+
+// cells lo..hi of row (or column) at
+typedef struct {
+	int at;
+	int lo;
+	int hi;
+} Run;
+
+SparseMap
+parse_sparse(const char *fn, Guard *g, Arena *a)
+{
+	FILE *f = fopen(fn, "r");
+	if (!f) {
+		perror("error opening file");
+		exit(EXIT_FAILURE);
+	}
+
+	// obstacles in reading order, (x, y) pairs, until the map's size
+	// is known; that order is already row-major
+	int *obs = NULL;
+	size_t n = 0, cap = 0;
+	char *line = NULL;
+	size_t line_cap = 0;
+	ssize_t len;
+	int rows = 0;
+	int cols = 0;
+	bool found = false;
+
+	while ((len = getline(&line, &line_cap, f)) != -1) {
+		if (line[len-1] == '\n') {
+			line[len-1] = '\0';
+			len--;
+		}
+		if (rows == 0) {
+			cols = len;
+		} else if (len != cols) {
+			fprintf(stderr, "Error: inconsistent row len in the map.\n");
+			exit(EXIT_FAILURE);
+		}
+		for (char *c = line; (c = memchr(c, '#', line + len - c)) != NULL; c++) {
+			if (n == cap) {
+				cap = cap ? cap * 2 : 1024;
+				obs = realloc(obs, sizeof(int) * 2 * cap);
+				if (!obs) {
+					fprintf(stderr, "failed to alloc memory for obstacles.\n");
+					exit(EXIT_FAILURE);
+				}
+			}
+			obs[2*n] = c - line;
+			obs[2*n+1] = rows;
+			n++;
+		}
+		char *c;
+		if (!found && (c = strpbrk(line, "^>v<")) != NULL) {
+			g->x = c - line;
+			g->y = rows;
+			g->dir = *c == '^' ? UP : *c == '>' ? RIGHT : *c == 'v' ? DOWN : LEFT;
+			found = true;
+		}
+		rows++;
+	}
+	free(line);
+	fclose(f);
+	if (!found) {
+		fprintf(stderr, "Error: no guard found in the map.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	SparseMap m = { .rows = rows, .cols = cols, .n = n };
+	m.row_start = arena_alloc(a, sizeof(int) * (rows+1), alignof(int));
+	m.col_start = arena_alloc(a, sizeof(int) * (cols+1), alignof(int));
+	m.row_x = arena_alloc(a, sizeof(int) * (n+1), alignof(int));
+	m.col_y = arena_alloc(a, sizeof(int) * (n+1), alignof(int));
+	if (!m.row_start || !m.col_start || !m.row_x || !m.col_y) {
+		fprintf(stderr, "failed to alloc mem for sparse map.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// counting sort both ways; reading order keeps each list ascending
+	memset(m.row_start, 0, sizeof(int) * (rows+1));
+	memset(m.col_start, 0, sizeof(int) * (cols+1));
+	for (size_t i = 0; i < n; i++) {
+		m.row_start[obs[2*i+1] + 1]++;
+		m.col_start[obs[2*i] + 1]++;
+	}
+	for (int y = 0; y < rows; y++)
+		m.row_start[y+1] += m.row_start[y];
+	for (int x = 0; x < cols; x++)
+		m.col_start[x+1] += m.col_start[x];
+	for (size_t i = 0; i < n; i++) {
+		m.row_x[i] = obs[2*i];
+		m.col_y[m.col_start[obs[2*i]]++] = obs[2*i+1];
+	}
+	// the scatter advanced every column start to the next one's
+	memmove(m.col_start + 1, m.col_start, sizeof(int) * cols);
+	m.col_start[0] = 0;
+	free(obs);
+	return m;
+}
+
+// index of the first of v[lo, hi) that is >= key; v ascending
+int
+lower_bound(const int *v, int lo, int hi, int key)
+{
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (v[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// walk the guard out of the map, one run per segment into hruns (along
+// a row) or vruns (along a column); the counts come back in *nh, *nv.
+// Returns false if the guard never leaves: every turn is at one of the
+// four faces of an obstacle, so more than 4n turns means a loop.
+bool
+walk_sparse(SparseMap m, Guard *g, Run *hruns, int *nh, Run *vruns, int *nv)
+{
+	*nh = *nv = 0;
+	for (long turns = 0; turns <= 4L * m.n; turns++) {
+		int x = g->x, y = g->y;
+		int rs = m.row_start[y], re = m.row_start[y+1];
+		int cs = m.col_start[x], ce = m.col_start[x+1];
+		int i;
+
+		switch (g->dir) {
+			case UP:
+				i = lower_bound(m.col_y, cs, ce, y);
+				g->y = i > cs ? m.col_y[i-1] + 1 : 0;
+				vruns[(*nv)++] = (Run){ x, g->y, y };
+				if (i == cs)
+					return true;
+				break;
+			case DOWN:
+				i = lower_bound(m.col_y, cs, ce, y);
+				g->y = i < ce ? m.col_y[i] - 1 : m.rows - 1;
+				vruns[(*nv)++] = (Run){ x, y, g->y };
+				if (i == ce)
+					return true;
+				break;
+			case LEFT:
+				i = lower_bound(m.row_x, rs, re, x);
+				g->x = i > rs ? m.row_x[i-1] + 1 : 0;
+				hruns[(*nh)++] = (Run){ y, g->x, x };
+				if (i == rs)
+					return true;
+				break;
+			case RIGHT:
+				i = lower_bound(m.row_x, rs, re, x);
+				g->x = i < re ? m.row_x[i] - 1 : m.cols - 1;
+				hruns[(*nh)++] = (Run){ y, x, g->x };
+				if (i == re)
+					return true;
+				break;
+		}
+		turn_90(g);
+	}
+	return false;
+}
+
+int
+cmp_run(const void *pa, const void *pb)
+{
+	const Run *a = pa, *b = pb;
+	if (a->at != b->at)
+		return a->at < b->at ? -1 : 1;
+	return (a->lo > b->lo) - (a->lo < b->lo);
+}
+
+int
+cmp_run_end(const void *pa, const void *pb)
+{
+	const Run *a = pa, *b = pb;
+	return (a->hi > b->hi) - (a->hi < b->hi);
+}
+
+// sort and merge overlapping runs in place; returns the new count and
+// adds the cells they cover to *cells
+int
+merge_runs(Run *r, int n, long *cells)
+{
+	int k = 0;
+
+	qsort(r, n, sizeof *r, cmp_run);
+	for (int i = 0; i < n; i++) {
+		if (k > 0 && r[k-1].at == r[i].at && r[i].lo <= r[k-1].hi + 1) {
+			if (r[i].hi > r[k-1].hi)
+				r[k-1].hi = r[i].hi;
+		} else {
+			r[k++] = r[i];
+		}
+	}
+	for (int i = 0; i < k; i++)
+		*cells += r[i].hi - r[i].lo + 1;
+	return k;
+}
+
+// Fenwick tree over the columns: which columns a vertical interval
+// covers in the row being swept (at most one each, they are disjoint)
+void
+bit_add(int *bit, int cols, int x, int d)
+{
+	for (x++; x <= cols; x += x & -x)
+		bit[x] += d;
+}
+
+long
+bit_sum(const int *bit, int x)
+{
+	long s = 0;
+	for (; x > 0; x -= x & -x)
+		s += bit[x];
+	return s;
+}
+
+long
+part_1_sparse(SparseMap m, Guard *g, Arena *a)
+{
+	size_t max_runs = 4 * (size_t)m.n + 1;
+	Run *hruns = arena_alloc(a, sizeof(Run) * max_runs, alignof(Run));
+	Run *vruns = arena_alloc(a, sizeof(Run) * max_runs, alignof(Run));
+	Run *ends = arena_alloc(a, sizeof(Run) * max_runs, alignof(Run));
+	int *bit = arena_alloc(a, sizeof(int) * (m.cols+1), alignof(int));
+	int nh, nv;
+	long cells = 0;
+
+	if (!hruns || !vruns || !ends || !bit) {
+		fprintf(stderr, "failed to alloc mem for guard runs.\n");
+		return -1;
+	}
+	if (!walk_sparse(m, g, hruns, &nh, vruns, &nv)) {
+		fprintf(stderr, "Error: the guard never leaves the map.\n");
+		return -1;
+	}
+	nh = merge_runs(hruns, nh, &cells);
+	nv = merge_runs(vruns, nv, &cells);
+
+	// sweep down the rows: a column interval is live from its lo row
+	// to its hi row; every live column a row interval spans is a cell
+	// counted twice.  vruns sort by lo for the starts, ends by hi.
+	for (int i = 0; i < nv; i++) {
+		int t = vruns[i].at;
+		vruns[i].at = vruns[i].lo;
+		vruns[i].lo = t;
+		ends[i] = vruns[i];
+	}
+	qsort(vruns, nv, sizeof *vruns, cmp_run);   // (lo row, column)
+	qsort(ends, nv, sizeof *ends, cmp_run_end);
+	memset(bit, 0, sizeof(int) * (m.cols+1));
+	for (int i = 0, si = 0, ei = 0; i < nh; i++) {
+		int y = hruns[i].at;
+		for (; si < nv && vruns[si].at <= y; si++)
+			bit_add(bit, m.cols, vruns[si].lo, 1);
+		for (; ei < nv && ends[ei].hi < y; ei++)
+			bit_add(bit, m.cols, ends[ei].lo, -1);
+		cells -= bit_sum(bit, hruns[i].hi + 1) - bit_sum(bit, hruns[i].lo);
+	}
+	return cells;
+}
+
 int
 main(int argc, char *argv[])
 {
-	if (argc != 2) {
-		fprintf(stderr, "Usage: %s <file>\n", argv[0]);
+	bool sparse = argc == 3 && strcmp(argv[1], "-s") == 0;
+	if (argc != 2 && !sparse) {
+		fprintf(stderr, "Usage: %s [-s] <file>\n", argv[0]);
 		return EXIT_FAILURE;
 	}
-	const char *fn = argv[1];
+	const char *fn = argv[argc-1];
 	Arena a;
-	Guard g;
+	Guard g = {0};
 	Map map;
 	bool **visited_set = NULL;
 	int distinct_visits = 0;
 	
-	a = arena_init(&a);	
-	if (!a) {
+	if (!arena_init(&a)) {
 		perror("arena init failed");
 		return EXIT_FAILURE;
 	}
 
+	uint64_t t;
+	if (sparse) {
+		t = aoc_trace_begin();
+		SparseMap sm = parse_sparse(fn, &g, &a);
+		aoc_trace_end("read+parse", t);
+		t = aoc_trace_begin();
+		long visits = part_1_sparse(sm, &g, &a);
+		aoc_trace_end("part 1", t);
+		arena_free(&a);
+		if (visits < 0)
+			return EXIT_FAILURE;
+		printf("Distinct positions visited: %ld\n", visits);
+		return EXIT_SUCCESS;
+	}
+
+	t = aoc_trace_begin();
 	map = parse_map(fn, &g, &a);
+	aoc_trace_end("read+parse", t);
 	if (!map.grid) {
 		perror("parsing map failed");
 		goto cleanup;
 	}
 
+	visited_set = arena_alloc(&a, sizeof(bool*) * map.rows, alignof(bool*));
+	if (!visited_set) {
+		perror("failed to alloc mem for visited_set");
+		goto cleanup;
+	}
 	for (int i = 0; i < map.rows; i++) {
-		visited_set[i] = arena_alloc(&a, sizeof(bool*) * map.rows, alignof(bool*));
-		turn_90(&g);
+		visited_set[i] = arena_alloc(&a, sizeof(bool) * map.cols, alignof(bool));
 		if (!visited_set[i]) {
 			perror("failed to alloc mem for visited_set");
 			goto cleanup;
 		}
 		memset(visited_set[i], 0, sizeof(bool) * map.cols);
 	}
-	distinct_visits = part_1(map, &g, visited_set, &a);
+	t = aoc_trace_begin();
+	distinct_visits = part_1(map, &g, visited_set);
+	aoc_trace_end("part 1", t);
 	printf("Distinct positions visited: %d\n", distinct_visits);
 
 cleanup:
@@ -1,97 +1,74 @@
 // day08.c - AoC 2024 Day 8: Resonant Collinearity (Parts 1 & 2)
-// Compile: cc -std=c2x -O2 -I../lib main.c -o day08
-// Run:     ./day08 < input.txt
+// Compile: make                      (PROFILE=release: see lib/profile.mk)
+// Run:     ./main < input.txt
+//          ./main FILE               (text, or lib/convert points output)
+//          ./main -b DIR|MANIFEST    (one JSON line per input, see batch())
+
+#define _GNU_SOURCE
 
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "aoc_batch.h"
+#include "aoc_bin.h"
+#include "aoc_trace.h"
+
 #define MAX_H  256
 #define MAX_W  256
-#define MAX_ANTENNAS (MAX_H * MAX_W)
-
-typedef struct {
-    int x;      // column index
-    int y;      // row index
-    char freq;  // antenna character
-} Antenna;
-
-int main(void) {
-    char line[MAX_W + 4];
-    char grid[MAX_H][MAX_W];
-    int width  = -1;
-    int height = 0;
-
-    while (fgets(line, sizeof line, stdin)) {
-        size_t len = strlen(line);
-
-        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
-            line[--len] = '\0';
-        }
-
-        if (len == 0) {
-            // Ignore empty lines
-            continue;
-        }
-
-        if (width < 0) {
-            width = (int)len;
-        }
 
-        if (height >= MAX_H) {
-            fprintf(stderr, "Grid too tall\n");
-            return 1;
-        }
-        if ((int)len != width) {
-            fprintf(stderr, "Non-rectangular grid row length\n");
-            return 1;
-        }
+// antennas as lib/aoc_bin.h AOC_BIN_POINTS records, sorted by frequency
+// then position, so a converted input is used in place
+typedef struct aoc_bin_point Antenna;
 
-        for (int x = 0; x < width; x++) {
-            grid[height][x] = line[x];
-        }
-        height++;
+static bool antenna_before(const Antenna *a, const Antenna *b) {
+    if (a->freq != b->freq) {
+        return a->freq < b->freq;
     }
-
-    if (width <= 0 || height <= 0) {
-        fprintf(stderr, "Empty input\n");
-        return 1;
+    if (a->row != b->row) {
+        return a->row < b->row;
     }
+    return a->col < b->col;
+}
 
-    // Collect antennas
-    Antenna ants[MAX_ANTENNAS];
-    int ant_count = 0;
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            char c = grid[y][x];
-            if (c != '.') {
-                if (ant_count >= MAX_ANTENNAS) {
-                    fprintf(stderr, "Too many antennas\n");
-                    return 1;
-                }
-                ants[ant_count].x    = x;
-                ants[ant_count].y    = y;
-                ants[ant_count].freq = c;
-                ant_count++;
-            }
+// NULL when n antennas fit a height x width grid and are in strictly
+// increasing (freq, row, col) order, as convert and parse_grid write
+// them; checked before a converted input is trusted.  A repeated
+// antenna would pair with itself at distance 0 and stall part 2.
+static const char *check_points(const Antenna *ants, size_t n, uint64_t height,
+                                uint64_t width) {
+    if (height == 0 || width == 0 || height > MAX_H || width > MAX_W) {
+        return "Bad grid size";
+    }
+    if (n > height * width) {
+        return "Too many antennas";
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (ants[i].row >= height || ants[i].col >= width) {
+            return "Antenna outside the grid";
+        }
+        if (i > 0 && !antenna_before(&ants[i - 1], &ants[i])) {
+            return "Antennas not sorted";
         }
     }
+    return NULL;
+}
 
+// Both parts over antennas grouped by frequency: only pairs within a
+// group are tried.
+static void solve_points(const Antenna *ants, int ant_count, int width,
+                         int height, int *part1, int *part2) {
     // Part 1: antinodes with 2x distance rule
+    uint64_t t = aoc_trace_begin();
     bool antinode1[MAX_H][MAX_W] = { false };
 
     for (int i = 0; i < ant_count; i++) {
-        for (int j = i + 1; j < ant_count; j++) {
-            if (ants[i].freq != ants[j].freq) {
-                continue;
-            }
-
-            int x1 = ants[i].x;
-            int y1 = ants[i].y;
-            int x2 = ants[j].x;
-            int y2 = ants[j].y;
+        for (int j = i + 1; j < ant_count && ants[j].freq == ants[i].freq; j++) {
+            int x1 = ants[i].col;
+            int y1 = ants[i].row;
+            int x2 = ants[j].col;
+            int y2 = ants[j].row;
 
             int dx = x2 - x1;
             int dy = y2 - y1;
@@ -123,19 +100,18 @@ int main(void) {
         }
     }
 
+    aoc_trace_end("part 1", t);
+
     // Part 2: antinodes at all collinear positions (resonant harmonics)
+    t = aoc_trace_begin();
     bool antinode2[MAX_H][MAX_W] = { false };
 
     for (int i = 0; i < ant_count; i++) {
-        for (int j = i + 1; j < ant_count; j++) {
-            if (ants[i].freq != ants[j].freq) {
-                continue;
-            }
-
-            int x1 = ants[i].x;
-            int y1 = ants[i].y;
-            int x2 = ants[j].x;
-            int y2 = ants[j].y;
+        for (int j = i + 1; j < ant_count && ants[j].freq == ants[i].freq; j++) {
+            int x1 = ants[i].col;
+            int y1 = ants[i].row;
+            int x2 = ants[j].col;
+            int y2 = ants[j].row;
 
             int dx = x2 - x1;
             int dy = y2 - y1;
@@ -169,9 +145,248 @@ int main(void) {
         }
     }
 
-    printf("Part 1: %d\n", count1);
-    printf("Part 2: %d\n", count2);
+    aoc_trace_end("part 2", t);
+
+    *part1 = count1;
+    *part2 = count2;
+}
 
+// Antennas ready to solve: read from text into own, or a converted
+// input's payload.
+struct points {
+    const Antenna *ants;
+    Antenna *own;
+    int count;
+    int width;
+    int height;
+};
+
+// Read one grid from in into *pt (pt->own freed by the caller); NULL on
+// success, else what was wrong.
+static const char *parse_grid(FILE *in, struct points *pt) {
+    char line[MAX_W + 4];
+    char grid[MAX_H][MAX_W];
+    int width  = -1;
+    int height = 0;
+    uint64_t t = aoc_trace_begin();
+
+    while (fgets(line, sizeof line, in)) {
+        size_t len = strlen(line);
+
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+
+        if (len == 0) {
+            // Ignore empty lines
+            continue;
+        }
+
+        if (width < 0) {
+            width = (int)len;
+        }
+
+        if (height >= MAX_H) {
+            return "Grid too tall";
+        }
+        if ((int)len != width) {
+            return "Non-rectangular grid row length";
+        }
+
+        for (int x = 0; x < width; x++) {
+            grid[height][x] = line[x];
+        }
+        height++;
+    }
+
+    aoc_trace_end("read", t);
+    if (width <= 0 || height <= 0) {
+        return "Empty input";
+    }
+
+    // Collect antennas, counted per frequency first so each lands in
+    // its group in row-major order
+    t = aoc_trace_begin();
+    int first[257] = { 0 };
+    int ant_count = 0;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char c = (unsigned char)grid[y][x];
+            if (c != '.') {
+                first[c + 1]++;
+                ant_count++;
+            }
+        }
+    }
+    for (int f = 1; f < 257; f++) {
+        first[f] += first[f - 1];
+    }
+    Antenna *ants = malloc((size_t)(ant_count ? ant_count : 1) * sizeof *ants);
+    if (!ants) {
+        return "Out of memory";
+    }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char c = (unsigned char)grid[y][x];
+            if (c != '.') {
+                Antenna *a = &ants[first[c]++];
+                a->row  = (uint16_t)y;
+                a->col  = (uint16_t)x;
+                a->freq = c;
+            }
+        }
+    }
+
+    aoc_trace_end("parse", t);
+
+    pt->ants   = pt->own = ants;
+    pt->count  = ant_count;
+    pt->width  = width;
+    pt->height = height;
+    return NULL;
+}
+
+// A converted input (lib/convert points), used where it lies: h is a
+// checked header, data its payload.
+static const char *bin_points(const struct aoc_bin_hdr *h, const uint8_t *data,
+                              struct points *pt) {
+    const Antenna *ants = (const Antenna *)data;
+    const char *err = check_points(ants, h->rows, h->aux[0], h->aux[1]);
+
+    if (!err) {
+        pt->ants   = ants;
+        pt->own    = NULL;
+        pt->count  = (int)h->rows;
+        pt->width  = (int)h->aux[1];
+        pt->height = (int)h->aux[0];
+    }
+    return err;
+}
+
+// One batch input made ready to solve, on the parse stage's thread.
+struct points_job {
+    struct points pt;
+    const char *err;
+};
+
+static void *parse_file(struct aoc_batch_file *f, void *arg) {
+    struct points_job *j = calloc(1, sizeof *j);
+
+    (void)arg;
+    if (!j) {
+        return NULL;
+    }
+    if (f->err) {
+        j->err = strerror(f->err);
+    } else if (f->n == 0) {
+        j->err = "Empty input";
+    } else if (f->n >= 4 && memcmp(f->p, AOC_BIN_MAGIC, 4) == 0) {
+        // converted: the antennas are used where they were read
+        j->err = aoc_bin_check(f->p, f->n, AOC_BIN_POINTS, 0);
+        if (!j->err) {
+            j->err = bin_points((const struct aoc_bin_hdr *)f->p,
+                                (const uint8_t *)f->p + sizeof(struct aoc_bin_hdr),
+                                &j->pt);
+        }
+    } else {
+        // a stream over the buffer, so parse_grid() reads it like stdin
+        FILE *in = fmemopen(f->p, f->n, "r");
+        j->err = in ? parse_grid(in, &j->pt) : strerror(errno);
+        if (in) {
+            fclose(in);
+        }
+    }
+    return j;
+}
+
+static void drop_job(void *parsed, void *arg) {
+    struct points_job *j = parsed;
+
+    (void)arg;
+    if (j) {
+        free(j->pt.own);
+    }
+    free(j);
+}
+
+// Every input in a directory or manifest, one JSON line each on stdout
+// and files/s on stderr; the next input is parsed while this one is
+// solved, and the ones after it read (lib/aoc_batch.h).
+static int batch(const char *src) {
+    struct aoc_batch b;
+    struct aoc_batch_file f;
+
+    if (!aoc_batch_open(&b, src)) {
+        fprintf(stderr, "%s: cannot list inputs\n", src);
+        return 1;
+    }
+    (void)aoc_batch_parse(&b, parse_file, drop_job, NULL);   // else in line
+    while (aoc_batch_next(&b, &f)) {
+        struct points_job *j = f.parsed;
+        double t0 = aoc_batch_clock();
+        const char *err = j ? j->err : "Out of memory";
+        int part1 = 0, part2 = 0;
+
+        if (!err) {
+            solve_points(j->pt.ants, j->pt.count, j->pt.width, j->pt.height,
+                         &part1, &part2);
+        }
+        drop_job(j, NULL);
+        free(f.p);
+
+        printf("{\"file\":");
+        aoc_json_str(stdout, f.path);
+        if (err) {
+            printf(",\"error\":");
+            aoc_json_str(stdout, err);
+            printf("}\n");
+        } else {
+            printf(",\"part1\":%d,\"part2\":%d,\"ms\":%.3f}\n",
+                   part1, part2, (aoc_batch_clock() - t0) * 1e3);
+        }
+    }
+    aoc_batch_report(&b, stderr);
+    aoc_batch_close(&b);
     return 0;
 }
 
+int main(int argc, char *argv[]) {
+    struct points pt = { 0 };
+    struct aoc_bin_map bin = { 0 };
+    int part1, part2;
+    const char *err;
+
+    if (argc == 3 && strcmp(argv[1], "-b") == 0) {
+        return batch(argv[2]);
+    }
+
+    if (argc == 2 && aoc_bin_is(argv[1])) {
+        // converted: no reading or parsing
+        uint64_t t = aoc_trace_begin();
+        int ok = aoc_bin_open(&bin, argv[1], AOC_BIN_POINTS, 0);
+
+        aoc_trace_end("map", t);
+        err = ok ? bin_points(bin.hdr, bin.data, &pt) : bin.err;
+    } else if (argc == 2) {
+        FILE *in = fopen(argv[1], "r");
+
+        err = in ? parse_grid(in, &pt) : strerror(errno);
+        if (in) {
+            fclose(in);
+        }
+    } else {
+        err = parse_grid(stdin, &pt);
+    }
+    if (err) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+    solve_points(pt.ants, pt.count, pt.width, pt.height, &part1, &part2);
+    printf("Part 1: %d\n", part1);
+    printf("Part 2: %d\n", part2);
+
+    aoc_bin_close(&bin);
+    free(pt.own);
+    return 0;
+}
@@ -1,7 +1,12 @@
+#define _GNU_SOURCE
+
 #include <stdint.h>
 #include <sys/types.h>
 
 #include "aoc.h"
+#include "aoc_batch.h"
+#include "aoc_bin.h"
+#include "aoc_trace.h"
 
 struct file_info {
     size_t start;
@@ -9,41 +14,34 @@ struct file_info {
 };
 
 /*
-    Expand s[] into disk[], fill files[], return count of files.
+    Expand nfiles run-length pairs (lib/aoc_bin.h AOC_BIN_RUNS: file
+    length in the low nibble, free run after it in the high one) into
+    disk[] and files[]; 0 when they do not add up to nblk blocks
 */
-static size_t
-expand_layout(const char *s, size_t len,
+static int
+expand_layout(const uint8_t *runs, size_t nfiles,
               int64_t *disk, size_t nblk,
-              struct file_info *files, size_t max_files)
+              struct file_info *files)
 {
     size_t pos = 0;
-    size_t fid = 0;
-
-    for (size_t i = 0; i < len; i++) {
-        int d = s[i] - '0';
 
-        if ((i & 1u) == 0) {
-            /* file run */
-            files[fid].start = pos;
-            files[fid].len   = (size_t)d;
+    for (size_t fid = 0; fid < nfiles; fid++) {
+        size_t len  = runs[fid] & 15u;
+        size_t free = runs[fid] >> 4;
 
-            for (int k = 0; k < d; k++)
-                disk[pos++] = (int64_t)fid;
+        if (len + free > nblk - pos)
+            return 0;
 
-            fid++;
-        } else {
-            /* free run */
-            for (int k = 0; k < d; k++)
-                disk[pos++] = -1;
-        }
-    }
+        files[fid].start = pos;
+        files[fid].len   = len;
 
-    if (pos != nblk) {
-        fprintf(stderr, "expand_layout internal error: pos=%zu nblk=%zu\n", pos, nblk);
-        exit(1);
+        for (size_t k = 0; k < len; k++)
+            disk[pos++] = (int64_t)fid;
+        for (size_t k = 0; k < free; k++)
+            disk[pos++] = -1;
     }
 
-    return fid;  /* file_count */
+    return pos == nblk;
 }
 
 /*
@@ -132,82 +130,256 @@ compute_part2(int64_t *disk,
 }
 
 
-int
-main(void)
+/*
+    Solve nfiles run-length pairs covering nblk blocks, as parsed from
+    text or mapped from a converted input; NULL on success, else why not
+*/
+static const char *
+solve_runs(const uint8_t *runs, size_t nfiles, size_t nblk,
+           uint64_t *part1, uint64_t *part2)
 {
-    struct aoc_buf b;
-
-    if (!read_file("input.txt", NULL, &b)) {
-        fprintf(stderr, "read failed\n");
-        return 1;
-    }
-
-    chomp(b.p);
-    char *s   = b.p;
-    size_t len = strlen(s);
-
-    if (len == 0) {
-        fprintf(stderr, "empty input\n");
-        free(b.p);
-        return 1;
-    }
-
-    /* total blocks */
-    size_t nblk = 0;
-    for (size_t i = 0; i < len; i++) {
-        int d = s[i] - '0';
-        if (d < 0 || d > 9) {
-            fprintf(stderr, "bad digit\n");
-            free(b.p);
-            return 1;
-        }
-        nblk += (size_t)d;
-    }
+    uint64_t t = aoc_trace_begin();
 
     /* allocate disk + file table */
     int64_t *disk = malloc(nblk * sizeof *disk);
     int64_t *disk_copy = malloc(nblk * sizeof *disk);
-    size_t   max_files = (len + 1u) / 2u;
-    struct file_info *files = malloc(max_files * sizeof *files);
-    struct file_info *files_copy = malloc(max_files * sizeof *files_copy);
+    struct file_info *files = malloc(nfiles * sizeof *files);
+    struct file_info *files_copy = malloc(nfiles * sizeof *files_copy);
 
     if (!disk || !disk_copy || !files || !files_copy) {
-        fprintf(stderr, "oom\n");
-        free(b.p);
         free(disk);
         free(disk_copy);
         free(files);
         free(files_copy);
-        return 1;
+        return "oom";
     }
 
     /*
-       Parse once, then copy for Part 1 and Part 2
+       Expand once, then copy for Part 1 and Part 2
     */
-    size_t file_count =
-        expand_layout(s, len, disk, nblk, files, max_files);
+    if (!expand_layout(runs, nfiles, disk, nblk, files)) {
+        free(disk);
+        free(disk_copy);
+        free(files);
+        free(files_copy);
+        return "runs do not add up to the block count";
+    }
 
-    memcpy(disk_copy, disk, nblk * sizeof *disk);
-    memcpy(files_copy, files, file_count * sizeof *files);
+    aoc_trace_end("expand", t);
 
     /* part 1 */
-    uint64_t part1 = compute_part1(disk_copy, nblk);
+    AOC_TRACE_SCOPE("part 1") {
+        memcpy(disk_copy, disk, nblk * sizeof *disk);
+        *part1 = compute_part1(disk_copy, nblk);
+    }
 
     /* restore and run part 2 */
-    memcpy(disk_copy, disk, nblk * sizeof *disk);
-    memcpy(files_copy, files, file_count * sizeof *files);
-
-    uint64_t part2 =
-        compute_part2(disk_copy, files_copy, file_count, nblk);
-
-    printf("Part 1: %llu\n", (unsigned long long)part1);
-    printf("Part 2: %llu\n", (unsigned long long)part2);
+    AOC_TRACE_SCOPE("part 2") {
+        memcpy(disk_copy, disk, nblk * sizeof *disk);
+        memcpy(files_copy, files, nfiles * sizeof *files);
+        *part2 = compute_part2(disk_copy, files_copy, nfiles, nblk);
+    }
 
-    free(b.p);
     free(disk);
     free(disk_copy);
     free(files);
     free(files_copy);
+    return NULL;
+}
+
+/*
+    Parse one disk map (s, NUL-terminated) into *runs (freed by the
+    caller) as file/free pairs, totalling the blocks; NULL on success,
+    else why not
+*/
+static const char *
+parse_text(char *s, uint8_t **runs, size_t *nfiles, size_t *nblk)
+{
+    uint64_t t = aoc_trace_begin();
+    chomp(s);
+    size_t len = strlen(s);
+
+    if (len == 0)
+        return "empty input";
+
+    /* validate and pack into file/free pairs, totalling the blocks */
+    uint8_t *r = calloc((len + 1u) / 2u, 1);
+    size_t blocks = 0;
+
+    if (!r)
+        return "oom";
+    for (size_t i = 0; i < len; i++) {
+        int d = s[i] - '0';
+        if (d < 0 || d > 9) {
+            free(r);
+            return "bad digit";
+        }
+        r[i >> 1] |= (uint8_t)(d << ((i & 1u) * 4u));
+        blocks += (size_t)d;
+    }
+
+    aoc_trace_end("parse", t);
+    *runs = r;
+    *nfiles = (len + 1u) / 2u;
+    *nblk = blocks;
+    return NULL;
+}
+
+/*
+    The run pairs of a converted input (lib/convert runs), h checked and
+    data its payload: used where they lie
+*/
+static const char *
+bin_runs(const struct aoc_bin_hdr *h, const uint8_t *data,
+         const uint8_t **runs, size_t *nfiles, size_t *nblk)
+{
+    if (h->rows != 1 || h->aux[0] > SIZE_MAX / sizeof(int64_t))
+        return "bad disk map header";
+    *runs = data;
+    *nfiles = h->cols;
+    *nblk = (size_t)h->aux[0];
+    return NULL;
+}
+
+/*
+    One batch input made ready to solve, by parse_file on the parse
+    stage's thread
+*/
+struct runs_job {
+    const uint8_t *runs;    /* own, or a converted input's payload */
+    uint8_t *own;
+    size_t nfiles;
+    size_t nblk;
+    const char *err;
+};
+
+static void *
+parse_file(struct aoc_batch_file *f, void *arg)
+{
+    struct runs_job *j = calloc(1, sizeof *j);
+
+    (void)arg;
+    if (!j)
+        return NULL;
+    if (f->err) {
+        j->err = strerror(f->err);
+    } else if (f->n >= 4 && memcmp(f->p, AOC_BIN_MAGIC, 4) == 0) {
+        /* converted: the pairs are expanded where they were read */
+        j->err = aoc_bin_check(f->p, f->n, AOC_BIN_RUNS, 0);
+        if (!j->err)
+            j->err = bin_runs((const struct aoc_bin_hdr *)f->p,
+                              (const uint8_t *)f->p + sizeof(struct aoc_bin_hdr),
+                              &j->runs, &j->nfiles, &j->nblk);
+    } else {
+        j->err = parse_text(f->p, &j->own, &j->nfiles, &j->nblk);
+        j->runs = j->own;
+    }
+    return j;
+}
+
+static void
+drop_job(void *parsed, void *arg)
+{
+    struct runs_job *j = parsed;
+
+    (void)arg;
+    if (j)
+        free(j->own);
+    free(j);
+}
+
+/*
+    -b DIR|MANIFEST: every input listed, one JSON line each on stdout and
+    files/s on stderr; the next input is parsed while this one is solved,
+    and the ones after it read
+*/
+static int
+batch(const char *src)
+{
+    struct aoc_batch b;
+    struct aoc_batch_file f;
+
+    if (!aoc_batch_open(&b, src)) {
+        fprintf(stderr, "%s: cannot list inputs\n", src);
+        return 1;
+    }
+    (void)aoc_batch_parse(&b, parse_file, drop_job, NULL);   /* else in line */
+    while (aoc_batch_next(&b, &f)) {
+        struct runs_job *j = f.parsed;
+        double t0 = aoc_batch_clock();
+        uint64_t part1 = 0, part2 = 0;
+        const char *err = !j ? "oom" : j->err;
+
+        if (!err)
+            err = solve_runs(j->runs, j->nfiles, j->nblk, &part1, &part2);
+        drop_job(j, NULL);
+        free(f.p);
+        printf("{\"file\":");
+        aoc_json_str(stdout, f.path);
+        if (err) {
+            printf(",\"error\":");
+            aoc_json_str(stdout, err);
+            printf("}\n");
+        } else {
+            printf(",\"part1\":%llu,\"part2\":%llu,\"ms\":%.3f}\n",
+                   (unsigned long long)part1, (unsigned long long)part2,
+                   (aoc_batch_clock() - t0) * 1e3);
+        }
+    }
+    aoc_batch_report(&b, stderr);
+    aoc_batch_close(&b);
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *fn = argc > 1 ? argv[1] : "input.txt";
+    struct aoc_buf b;
+    uint64_t part1, part2;
+    const char *err;
+
+    if (argc == 3 && strcmp(argv[1], "-b") == 0)
+        return batch(argv[2]);
+
+    /* a converted input (lib/convert runs) needs no reading or parsing */
+    if (aoc_bin_is(fn)) {
+        struct aoc_bin_map bin;
+        uint64_t t = aoc_trace_begin();
+        int ok = aoc_bin_open(&bin, fn, AOC_BIN_RUNS, 0);
+
+        const uint8_t *runs = NULL;
+        size_t nfiles = 0, nblk = 0;
+
+        aoc_trace_end("map", t);
+        err = ok ? bin_runs(bin.hdr, bin.data, &runs, &nfiles, &nblk) : bin.err;
+        if (!err)
+            err = solve_runs(runs, nfiles, nblk, &part1, &part2);
+        aoc_bin_close(&bin);
+    } else {
+        uint64_t t = aoc_trace_begin();
+        if (!read_file(fn, NULL, &b)) {
+            fprintf(stderr, "read failed\n");
+            return 1;
+        }
+        aoc_trace_end("read", t);
+
+        uint8_t *runs = NULL;
+        size_t nfiles = 0, nblk = 0;
+
+        err = parse_text(b.p, &runs, &nfiles, &nblk);
+        if (!err)
+            err = solve_runs(runs, nfiles, nblk, &part1, &part2);
+        free(runs);
+        free(b.p);
+    }
+    if (err) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+
+    printf("Part 1: %llu\n", (unsigned long long)part1);
+    printf("Part 2: %llu\n", (unsigned long long)part2);
 
     return 0;
 }
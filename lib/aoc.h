@@ -8,16 +8,55 @@
 #ifndef AOC_H
 #define AOC_H
 
-void
-check(int cond, const char *expr, int line)
+/*
+ * Assertions come in three tiers.  AOC_ASSERT_LEVEL selects how many are
+ * compiled in: the default is 1, or 0 under NDEBUG.
+ *
+ *   ASSERT(c)   every level: input validation, allocation and capacity
+ *               checks, and calls kept for their effect, as in
+ *               ASSERT(aoc_fifo_push(...)).  c is always evaluated.
+ *   DASSERT(c)  level >= 1: invariants of the code itself, including
+ *               those inside hot loops.
+ *   PASSERT(c)  level >= 2: paranoid checks that rescan whole structures,
+ *               far too slow for real inputs.
+ *
+ * A check that is compiled out is never evaluated, so it must have no
+ * side effects, but it still has to compile.  A failed check prints the
+ * expression and its location, then exits.  The failure path is out of
+ * line and cold, so a check that passes costs only a predicted branch.
+ */
+#ifndef AOC_ASSERT_LEVEL
+#ifdef NDEBUG
+#define AOC_ASSERT_LEVEL 0
+#else
+#define AOC_ASSERT_LEVEL 1
+#endif
+#endif
+
+__attribute__((noreturn, cold, noinline, unused)) static void
+aoc_assert_fail(const char *expr, const char *file, int line)
 {
-    if (!cond) {
-        fprintf(stderr, "assertion failed: %s (line %d)\n", expr, line);
-        exit(1);
-    }
+  fprintf(stderr, "assertion failed: %s (%s:%d)\n", expr, file, line);
+  exit(1);
 }
 
-#define ASSERT(c) check((c), #c, __LINE__)
+#define AOC_CHECK_(c) \
+  (__builtin_expect(!!(c), 1) ? (void)0 : aoc_assert_fail(#c, __FILE__, __LINE__))
+#define AOC_SKIP_(c) ((void)sizeof(!(c)))
+
+#define ASSERT(c) AOC_CHECK_(c)
+
+#if AOC_ASSERT_LEVEL >= 1
+#define DASSERT(c) AOC_CHECK_(c)
+#else
+#define DASSERT(c) AOC_SKIP_(c)
+#endif
+
+#if AOC_ASSERT_LEVEL >= 2
+#define PASSERT(c) AOC_CHECK_(c)
+#else
+#define PASSERT(c) AOC_SKIP_(c)
+#endif
 
 struct aoc_buf {
   char *p;
@@ -94,6 +133,29 @@ aoc_alloc(struct aoc_arena *a, size_t n)
 #define aoc_new(arena, type, count) \
   ((type *)aoc_alloc((arena), sizeof(type) * (size_t)(count)))
 
+/* undo aoc_alloc: arena blocks stay until the arena is reset */
+static inline void
+aoc_release(struct aoc_arena *a, void *p)
+{
+  if (!a)
+    free(p);
+}
+
+/* grow *p of n elements of size sz to cap elements */
+[[nodiscard]] static inline int
+aoc_grow(struct aoc_arena *a, void **p, size_t n, size_t cap, size_t sz)
+{
+  void *np = aoc_alloc(a, cap * sz);
+
+  if (!np)
+    return 0;
+  if (n > 0)
+    memcpy(np, *p, n * sz);
+  aoc_release(a, *p);
+  *p = np;
+  return 1;
+}
+
 [[nodiscard]] static inline int
 read_file(const char *path, struct aoc_arena *a, struct aoc_buf *b)
 {
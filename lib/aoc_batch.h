@@ -0,0 +1,727 @@
+#ifndef AOC_BATCH_H
+#define AOC_BATCH_H
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "aoc_trace.h"
+
+/*
+ * Batch input: many files, read ahead while the caller solves.
+ *
+ *   struct aoc_batch b;
+ *   struct aoc_batch_file f;
+ *
+ *   aoc_batch_open(&b, "inputs/");      a directory, or a manifest file
+ *   while (aoc_batch_next(&b, &f)) {     with one path per line
+ *     ... solve f.p (f.n bytes, NUL-terminated), or report f.err ...
+ *     free(f.p);
+ *   }
+ *   aoc_batch_report(&b, stderr);       files/s and MB/s
+ *   aoc_batch_close(&b);
+ *
+ * With aoc_batch_parse(&b, parse, drop, arg) after the open, a parser
+ * thread runs parse(&f, arg) over the files in order, up to
+ * AOC_BATCH_AHEAD ahead of the caller, and aoc_batch_next() hands back
+ * each file with its result in f.parsed.  The caller then solves file N
+ * while file N+1 is being parsed and later ones read, and owns f.parsed
+ * as well as f.p; results never handed out go to drop(parsed, arg) at
+ * aoc_batch_close().  parse must cope with f.err and keep to its own
+ * state, since it runs beside the solver.
+ *
+ * Files come back in order (directory entries sorted by name), but up
+ * to AOC_BATCH_DEPTH of the following ones are already being read, so
+ * the disk works while the caller parses and solves.  Reads go through
+ * an io_uring when the kernel offers one; otherwise (or with
+ * AOC_BATCH_IO=threads) a reader thread fills the same window.  Opening
+ * a file stays synchronous: it is a metadata lookup, not the transfer.
+ * Should io_uring_enter() fail mid-batch, the reads the kernel already
+ * holds are waited out before the reader thread takes over, so no
+ * buffer is freed under a read.
+ *
+ * Result records quote strings with aoc_json_str() from aoc_trace.h.
+ * Linux only; C callers define _GNU_SOURCE first.
+ */
+
+#ifndef AOC_BATCH_DEPTH
+#define AOC_BATCH_DEPTH 16u
+#endif
+
+#ifndef AOC_BATCH_AHEAD
+#define AOC_BATCH_AHEAD 2u      /* parsed files waiting for the caller */
+#endif
+
+struct aoc_batch_file {
+  const char *path;
+  char *p;          /* contents plus a NUL, owned by the caller; NULL on error */
+  size_t n;
+  int err;          /* errno of a failed open or read, else 0 */
+  void *parsed;     /* what parse() returned, with aoc_batch_parse */
+};
+
+typedef void *(*aoc_batch_parse_fn)(struct aoc_batch_file *f, void *arg);
+typedef void (*aoc_batch_drop_fn)(void *parsed, void *arg);
+
+enum { AOC_SLOT_FREE, AOC_SLOT_LOADING, AOC_SLOT_READY };
+
+struct aoc_batch_slot {
+  size_t idx;       /* file index */
+  int state;
+  int fd;
+  char *p;
+  size_t n;
+  size_t got;
+  int err;
+  int queued;       /* a read of it is in the SQ ring or the kernel */
+};
+
+struct aoc_batch_uring {
+  int fd;
+  void *sq_map, *cq_map;
+  size_t sq_len, cq_len;
+  struct io_uring_sqe *sqes;
+  size_t sqes_len;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_cqe *cqes;
+};
+
+struct aoc_batch {
+  char **paths;
+  size_t npaths;
+  size_t submitted;   /* files handed to the reader */
+  size_t taken;       /* files handed to the caller */
+  size_t bytes;
+  double t0;
+  int uring;          /* 1: io_uring, 0: reader thread */
+  struct aoc_batch_slot slot[AOC_BATCH_DEPTH];
+  struct aoc_batch_uring ur;
+  pthread_t reader;
+  pthread_mutex_t mu;
+  pthread_cond_t cv;
+  int stop;
+  int running;        /* reader thread started; if neither this nor
+                         uring, files are read in aoc_batch_next */
+  /* parse stage, with aoc_batch_parse; the parser thread is the only
+     one to take files from the reader while it runs */
+  aoc_batch_parse_fn parse;
+  aoc_batch_drop_fn drop;
+  void *parse_arg;
+  struct aoc_batch_file ahead[AOC_BATCH_AHEAD];
+  size_t parsed;      /* files parse() has finished */
+  size_t handed;      /* parsed files handed to the caller */
+  pthread_t parser;
+  pthread_mutex_t pmu;
+  pthread_cond_t pcv;
+  int pstop;
+  int pdone;          /* the parser took the last file */
+  int parsing;        /* parser thread started */
+};
+
+static inline double
+aoc_batch_clock(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* ------------------------------------------------------------- file list */
+
+static inline int
+aoc_batch_add(struct aoc_batch *b, size_t *cap, const char *dir, const char *name)
+{
+  size_t n = (dir ? strlen(dir) + 1 : 0) + strlen(name) + 1;
+  char *s;
+
+  if (b->npaths == *cap) {
+    size_t c = *cap ? *cap * 2 : 64;
+    char **p = (char **)realloc(b->paths, c * sizeof *p);
+    if (!p)
+      return 0;
+    b->paths = p;
+    *cap = c;
+  }
+  s = (char *)malloc(n);
+  if (!s)
+    return 0;
+  if (dir)
+    snprintf(s, n, "%s/%s", dir, name);
+  else
+    snprintf(s, n, "%s", name);
+  b->paths[b->npaths++] = s;
+  return 1;
+}
+
+static inline int
+aoc_batch_cmp(const void *a, const void *b)
+{
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* regular files in dir, or the lines of a manifest, into b->paths */
+static inline int
+aoc_batch_list(struct aoc_batch *b, const char *src)
+{
+  struct stat st;
+  size_t cap = 0;
+
+  if (stat(src, &st) != 0)
+    return 0;
+  if (S_ISDIR(st.st_mode)) {
+    DIR *d = opendir(src);
+    struct dirent *e;
+
+    if (!d)
+      return 0;
+    while ((e = readdir(d)) != NULL) {
+      struct stat fst;
+      if (e->d_name[0] == '.')
+        continue;
+      if (!aoc_batch_add(b, &cap, src, e->d_name)) {
+        closedir(d);
+        return 0;
+      }
+      if (stat(b->paths[b->npaths - 1], &fst) != 0 || !S_ISREG(fst.st_mode))
+        free(b->paths[--b->npaths]);
+    }
+    closedir(d);
+    qsort(b->paths, b->npaths, sizeof *b->paths, aoc_batch_cmp);
+  } else {
+    FILE *f = fopen(src, "r");
+    char *line = NULL;
+    size_t lcap = 0;
+    ssize_t len;
+
+    if (!f)
+      return 0;
+    while ((len = getline(&line, &lcap, f)) != -1) {
+      while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        line[--len] = '\0';
+      if (len > 0 && line[0] != '#' && !aoc_batch_add(b, &cap, NULL, line)) {
+        free(line);
+        fclose(f);
+        return 0;
+      }
+    }
+    free(line);
+    fclose(f);
+  }
+  return 1;
+}
+
+/* ------------------------------------------------------------ slot reads */
+
+/* open and size the file, allocate its buffer; 0 when it needs no read */
+static inline int
+aoc_batch_start(struct aoc_batch_slot *s, const char *path)
+{
+  struct stat st;
+
+  s->p = NULL;
+  s->n = s->got = 0;
+  s->err = 0;
+  s->fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (s->fd < 0 || fstat(s->fd, &st) != 0) {
+    s->err = errno;
+    return 0;
+  }
+  s->n = (size_t)st.st_size;
+  s->p = (char *)malloc(s->n + 1);
+  if (!s->p) {
+    s->err = ENOMEM;
+    return 0;
+  }
+  s->p[s->n] = '\0';
+  return s->n > 0;
+}
+
+/* read the rest of a started slot with plain preads */
+static inline void
+aoc_batch_read_rest(struct aoc_batch_slot *s)
+{
+  while (s->got < s->n) {
+    ssize_t r = pread(s->fd, s->p + s->got, s->n - s->got, (off_t)s->got);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r < 0)
+      s->err = errno;
+    if (r <= 0)
+      break;
+    s->got += (size_t)r;
+  }
+}
+
+static inline void
+aoc_batch_finish(struct aoc_batch_slot *s)
+{
+  if (s->fd >= 0)
+    close(s->fd);
+  s->fd = -1;
+  if (s->err) {
+    free(s->p);
+    s->p = NULL;
+  } else {
+    s->n = s->got;
+    s->p[s->n] = '\0';
+  }
+  s->state = AOC_SLOT_READY;
+}
+
+/* ---------------------------------------------------------------- uring */
+
+static inline int
+aoc_uring_init(struct aoc_batch_uring *u, unsigned entries)
+{
+  struct io_uring_params p;
+
+  memset(&p, 0, sizeof p);
+  u->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+  if (u->fd < 0)
+    return 0;
+  u->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  u->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    u->sq_len = u->cq_len = u->sq_len > u->cq_len ? u->sq_len : u->cq_len;
+  u->sq_map = mmap(NULL, u->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   u->fd, IORING_OFF_SQ_RING);
+  u->cq_map = (p.features & IORING_FEAT_SINGLE_MMAP) ? u->sq_map
+              : mmap(NULL, u->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     u->fd, IORING_OFF_CQ_RING);
+  u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = (struct io_uring_sqe *)mmap(NULL, u->sqes_len,
+                                        PROT_READ | PROT_WRITE, MAP_SHARED,
+                                        u->fd, IORING_OFF_SQES);
+  if (u->sq_map == MAP_FAILED || u->cq_map == MAP_FAILED ||
+      u->sqes == MAP_FAILED) {
+    close(u->fd);
+    u->fd = -1;
+    return 0;
+  }
+  u->sq_head = (unsigned *)((char *)u->sq_map + p.sq_off.head);
+  u->sq_tail = (unsigned *)((char *)u->sq_map + p.sq_off.tail);
+  u->sq_mask = (unsigned *)((char *)u->sq_map + p.sq_off.ring_mask);
+  u->sq_array = (unsigned *)((char *)u->sq_map + p.sq_off.array);
+  u->cq_head = (unsigned *)((char *)u->cq_map + p.cq_off.head);
+  u->cq_tail = (unsigned *)((char *)u->cq_map + p.cq_off.tail);
+  u->cq_mask = (unsigned *)((char *)u->cq_map + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)((char *)u->cq_map + p.cq_off.cqes);
+  return 1;
+}
+
+static inline void
+aoc_uring_free(struct aoc_batch_uring *u)
+{
+  if (u->fd < 0)
+    return;
+  munmap(u->sqes, u->sqes_len);
+  if (u->cq_map != u->sq_map)
+    munmap(u->cq_map, u->cq_len);
+  munmap(u->sq_map, u->sq_len);
+  close(u->fd);
+  u->fd = -1;
+}
+
+/* queue a read of the rest of slot k; submitted by aoc_uring_enter */
+static inline void
+aoc_uring_read(struct aoc_batch_uring *u, struct aoc_batch_slot *s, unsigned k)
+{
+  unsigned tail = *u->sq_tail;
+  unsigned i = tail & *u->sq_mask;
+  struct io_uring_sqe *e = &u->sqes[i];
+  size_t left = s->n - s->got;
+
+  memset(e, 0, sizeof *e);
+  e->opcode = IORING_OP_READ;
+  e->fd = s->fd;
+  e->addr = (uint64_t)(uintptr_t)(s->p + s->got);
+  e->len = left > 0x7ffff000u ? 0x7ffff000u : (unsigned)left;
+  e->off = s->got;
+  e->user_data = k;
+  u->sq_array[i] = i;
+  s->queued = 1;
+  __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static inline int
+aoc_uring_enter(struct aoc_batch_uring *u, unsigned submit, unsigned wait)
+{
+  int r;
+
+  do {
+    r = (int)syscall(__NR_io_uring_enter, u->fd, submit, wait,
+                     wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+  } while (r < 0 && errno == EINTR);
+  return r;
+}
+
+/* submit every queued read not yet taken by the kernel (a failed enter
+   leaves them in the ring), optionally waiting for one completion */
+static inline int
+aoc_uring_submit(struct aoc_batch_uring *u, unsigned wait)
+{
+  unsigned pending = *u->sq_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+
+  if (!pending && !wait)
+    return 1;
+  return aoc_uring_enter(u, pending, wait) >= 0;
+}
+
+/* apply every completion; short reads are queued again when requeue
+   is set, else left LOADING for the caller */
+static inline void
+aoc_uring_reap(struct aoc_batch *b, int requeue)
+{
+  struct aoc_batch_uring *u = &b->ur;
+  unsigned head = *u->cq_head;
+
+  while (head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe *c = &u->cqes[head & *u->cq_mask];
+    struct aoc_batch_slot *s = &b->slot[c->user_data];
+
+    s->queued = 0;
+    if (c->res < 0) {
+      s->err = -c->res;
+      aoc_batch_finish(s);
+    } else if (c->res == 0 || (s->got += (size_t)c->res) == s->n) {
+      aoc_batch_finish(s);   /* done, or the file shrank under us */
+    } else if (requeue) {
+      aoc_uring_read(u, s, (unsigned)c->user_data);
+    }
+    head++;
+  }
+  __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* wait until the kernel holds no read into a slot buffer: entries it
+   never took go with the ring, the rest are reaped as they complete
+   (they post to the CQ ring without an enter) */
+static inline void
+aoc_uring_drain(struct aoc_batch *b)
+{
+  struct aoc_batch_uring *u = &b->ur;
+  unsigned head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+  struct timespec nap = { 0, 100000 };
+
+  for (; head != *u->sq_tail; head++)
+    b->slot[u->sqes[u->sq_array[head & *u->sq_mask]].user_data].queued = 0;
+  for (;;) {
+    int busy = 0;
+
+    aoc_uring_reap(b, 0);
+    for (unsigned k = 0; k < AOC_BATCH_DEPTH; k++)
+      busy |= b->slot[k].queued;
+    if (!busy)
+      break;
+    nanosleep(&nap, NULL);
+  }
+}
+
+static inline void *aoc_batch_reader(void *arg);
+
+static inline void
+aoc_batch_spawn(struct aoc_batch *b)
+{
+  pthread_mutex_init(&b->mu, NULL);
+  pthread_cond_init(&b->cv, NULL);
+  b->running = pthread_create(&b->reader, NULL, aoc_batch_reader, b) == 0;
+}
+
+/* io_uring_enter failed: drain the ring, finish the window with plain
+   reads and hand the files after it to the reader thread */
+static inline void
+aoc_uring_fallback(struct aoc_batch *b)
+{
+  aoc_uring_drain(b);
+  aoc_uring_free(&b->ur);
+  b->uring = 0;
+  for (unsigned k = 0; k < AOC_BATCH_DEPTH; k++) {
+    struct aoc_batch_slot *s = &b->slot[k];
+    if (s->state == AOC_SLOT_LOADING) {
+      aoc_batch_read_rest(s);
+      aoc_batch_finish(s);
+    }
+  }
+  aoc_batch_spawn(b);
+}
+
+/* fill every free slot in the window with the next files, and submit
+   them with any short reads queued again since the last enter */
+static inline void
+aoc_uring_fill(struct aoc_batch *b)
+{
+  while (b->submitted < b->npaths && b->submitted - b->taken < AOC_BATCH_DEPTH) {
+    unsigned k = (unsigned)(b->submitted % AOC_BATCH_DEPTH);
+    struct aoc_batch_slot *s = &b->slot[k];
+
+    s->idx = b->submitted++;
+    s->state = AOC_SLOT_LOADING;
+    if (aoc_batch_start(s, b->paths[s->idx]))
+      aoc_uring_read(&b->ur, s, k);
+    else
+      aoc_batch_finish(s);
+  }
+  if (!aoc_uring_submit(&b->ur, 0))
+    aoc_uring_fallback(b);
+}
+
+/* --------------------------------------------------------- reader thread */
+
+static inline void *
+aoc_batch_reader(void *arg)
+{
+  struct aoc_batch *b = (struct aoc_batch *)arg;
+
+  pthread_mutex_lock(&b->mu);
+  for (;;) {
+    while (!b->stop && b->submitted < b->npaths &&
+           b->submitted - b->taken >= AOC_BATCH_DEPTH)
+      pthread_cond_wait(&b->cv, &b->mu);
+    if (b->stop || b->submitted >= b->npaths)
+      break;
+    struct aoc_batch_slot *s = &b->slot[b->submitted % AOC_BATCH_DEPTH];
+    s->idx = b->submitted++;
+    s->state = AOC_SLOT_LOADING;
+    pthread_mutex_unlock(&b->mu);
+
+    if (aoc_batch_start(s, b->paths[s->idx]))
+      aoc_batch_read_rest(s);
+
+    pthread_mutex_lock(&b->mu);
+    aoc_batch_finish(s);
+    pthread_cond_broadcast(&b->cv);
+  }
+  pthread_mutex_unlock(&b->mu);
+  return NULL;
+}
+
+/* ------------------------------------------------------------------- api */
+
+[[nodiscard]] static inline int
+aoc_batch_open(struct aoc_batch *b, const char *src)
+{
+  const char *io = getenv("AOC_BATCH_IO");
+
+  memset(b, 0, sizeof *b);
+  b->ur.fd = -1;
+  for (unsigned k = 0; k < AOC_BATCH_DEPTH; k++)
+    b->slot[k].fd = -1;
+  if (!aoc_batch_list(b, src))
+    return 0;
+  b->t0 = aoc_batch_clock();
+  b->uring = !(io && strcmp(io, "threads") == 0) &&
+             aoc_uring_init(&b->ur, AOC_BATCH_DEPTH);
+  if (b->uring) {
+    aoc_uring_fill(b);
+    return 1;
+  }
+  aoc_batch_spawn(b);
+  return b->running;
+}
+
+/* the next file in order, waiting for its read; 0 after the last */
+static inline int
+aoc_batch_fetch(struct aoc_batch *b, struct aoc_batch_file *f)
+{
+  struct aoc_batch_slot *s;
+
+  if (b->taken >= b->npaths)
+    return 0;
+  s = &b->slot[b->taken % AOC_BATCH_DEPTH];
+  if (b->uring) {
+    aoc_uring_reap(b, 1);
+    while (b->uring && s->state != AOC_SLOT_READY) {
+      if (aoc_uring_submit(&b->ur, 1))
+        aoc_uring_reap(b, 1);
+      else
+        aoc_uring_fallback(b);
+    }
+  }
+  if (b->running) {
+    pthread_mutex_lock(&b->mu);
+    while (b->taken >= b->submitted || s->state != AOC_SLOT_READY)
+      pthread_cond_wait(&b->cv, &b->mu);
+  } else if (!b->uring && b->taken == b->submitted) {
+    /* no reader thread could be started after a fallback */
+    s->idx = b->submitted++;
+    s->state = AOC_SLOT_LOADING;
+    if (aoc_batch_start(s, b->paths[s->idx]))
+      aoc_batch_read_rest(s);
+    aoc_batch_finish(s);
+  }
+
+  f->path = b->paths[s->idx];
+  f->p = s->p;
+  f->n = s->p ? s->n : 0;
+  f->err = s->err;
+  f->parsed = NULL;
+  b->bytes += f->n;
+  s->state = AOC_SLOT_FREE;
+  s->p = NULL;
+  b->taken++;
+
+  if (b->uring) {
+    aoc_uring_fill(b);
+  } else if (b->running) {
+    pthread_cond_broadcast(&b->cv);
+    pthread_mutex_unlock(&b->mu);
+  }
+  return 1;
+}
+
+/* ----------------------------------------------------------- parse stage */
+
+static inline void *
+aoc_batch_parser(void *arg)
+{
+  struct aoc_batch *b = (struct aoc_batch *)arg;
+  struct aoc_batch_file f;
+
+  for (;;) {
+    pthread_mutex_lock(&b->pmu);
+    while (!b->pstop && b->parsed - b->handed >= AOC_BATCH_AHEAD)
+      pthread_cond_wait(&b->pcv, &b->pmu);
+    if (b->pstop) {
+      pthread_mutex_unlock(&b->pmu);
+      break;
+    }
+    pthread_mutex_unlock(&b->pmu);
+
+    if (!aoc_batch_fetch(b, &f))
+      break;
+    f.parsed = b->parse(&f, b->parse_arg);
+
+    pthread_mutex_lock(&b->pmu);
+    b->ahead[b->parsed++ % AOC_BATCH_AHEAD] = f;
+    pthread_cond_broadcast(&b->pcv);
+    pthread_mutex_unlock(&b->pmu);
+  }
+  pthread_mutex_lock(&b->pmu);
+  b->pdone = 1;
+  pthread_cond_broadcast(&b->pcv);
+  pthread_mutex_unlock(&b->pmu);
+  return NULL;
+}
+
+/* parse each file on a thread of its own, ahead of the caller; without
+   one (0 returned) aoc_batch_next parses in line instead */
+static inline int
+aoc_batch_parse(struct aoc_batch *b, aoc_batch_parse_fn parse,
+                aoc_batch_drop_fn drop, void *arg)
+{
+  b->parse = parse;
+  b->drop = drop;
+  b->parse_arg = arg;
+  pthread_mutex_init(&b->pmu, NULL);
+  pthread_cond_init(&b->pcv, NULL);
+  b->parsing = pthread_create(&b->parser, NULL, aoc_batch_parser, b) == 0;
+  return b->parsing;
+}
+
+/* the next file in order, parsed when a parse stage is set up; 0 after
+   the last */
+static inline int
+aoc_batch_next(struct aoc_batch *b, struct aoc_batch_file *f)
+{
+  if (!b->parse)
+    return aoc_batch_fetch(b, f);
+  if (!b->parsing) {
+    if (!aoc_batch_fetch(b, f))
+      return 0;
+    f->parsed = b->parse(f, b->parse_arg);
+    return 1;
+  }
+
+  pthread_mutex_lock(&b->pmu);
+  while (b->handed == b->parsed && !b->pdone)
+    pthread_cond_wait(&b->pcv, &b->pmu);
+  if (b->handed == b->parsed) {
+    pthread_mutex_unlock(&b->pmu);
+    pthread_join(b->parser, NULL);   /* so the report reads settled counts */
+    b->parsing = 0;
+    return 0;
+  }
+  *f = b->ahead[b->handed++ % AOC_BATCH_AHEAD];
+  pthread_cond_broadcast(&b->pcv);
+  pthread_mutex_unlock(&b->pmu);
+  return 1;
+}
+
+static inline const char *
+aoc_batch_engine(const struct aoc_batch *b)
+{
+  return b->uring ? "io_uring" : b->running ? "threads" : "inline";
+}
+
+/* files/s and MB/s so far, one line */
+static inline void
+aoc_batch_report(const struct aoc_batch *b, FILE *out)
+{
+  double s = aoc_batch_clock() - b->t0;
+
+  if (s <= 0)
+    s = 1e-9;
+  fprintf(out, "batch: %zu files, %.1f MB in %.3f s: %.1f files/s, %.1f MB/s (%s)\n",
+          b->taken, (double)b->bytes / 1e6, s, (double)b->taken / s,
+          (double)b->bytes / 1e6 / s, aoc_batch_engine(b));
+}
+
+static inline void
+aoc_batch_close(struct aoc_batch *b)
+{
+  if (b->parsing) {
+    /* the caller stopped early: the parser's results go to drop */
+    pthread_mutex_lock(&b->pmu);
+    b->pstop = 1;
+    pthread_cond_broadcast(&b->pcv);
+    pthread_mutex_unlock(&b->pmu);
+    pthread_join(b->parser, NULL);
+    for (; b->handed < b->parsed; b->handed++) {
+      struct aoc_batch_file *f = &b->ahead[b->handed % AOC_BATCH_AHEAD];
+      if (b->drop)
+        b->drop(f->parsed, b->parse_arg);
+      free(f->p);
+    }
+  }
+  if (b->parse) {
+    pthread_mutex_destroy(&b->pmu);
+    pthread_cond_destroy(&b->pcv);
+  }
+  if (b->uring) {
+    /* no read may still be in flight when the buffers go */
+    aoc_uring_drain(b);
+    aoc_uring_free(&b->ur);
+  } else if (b->running) {
+    pthread_mutex_lock(&b->mu);
+    b->stop = 1;
+    pthread_cond_broadcast(&b->cv);
+    pthread_mutex_unlock(&b->mu);
+    pthread_join(b->reader, NULL);
+    pthread_mutex_destroy(&b->mu);
+    pthread_cond_destroy(&b->cv);
+  }
+  for (unsigned k = 0; k < AOC_BATCH_DEPTH; k++) {
+    if (b->slot[k].fd >= 0)
+      close(b->slot[k].fd);   /* a short read the drain left LOADING */
+    free(b->slot[k].p);
+  }
+  for (size_t i = 0; i < b->npaths; i++)
+    free(b->paths[i]);
+  free(b->paths);
+  b->paths = NULL;
+}
+
+#endif /* AOC_BATCH_H */
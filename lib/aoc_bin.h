@@ -0,0 +1,265 @@
+#ifndef AOC_BIN_H
+#define AOC_BIN_H
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Pre-parsed puzzle inputs: a 64-byte header, then rows of packed cells.
+ *
+ *   AOC_BIN_NIBBLES  one 4-bit value per cell, low nibble first
+ *                    (day10 heights)
+ *   AOC_BIN_BITS     one bit per cell, LSB first, 1 = open (day16 walls;
+ *                    aux[0], aux[1] are the S and E cells, row * cols + col)
+ *   AOC_BIN_RUNS     one row of cols run-length pairs, a byte per file:
+ *                    its length in the low nibble, the free run after it
+ *                    in the high one (day9 disk map; aux[0] is the total
+ *                    blocks)
+ *   AOC_BIN_POINTS   one struct aoc_bin_point per row, strictly sorted by
+ *                    frequency, then row, then column (day8 antennas;
+ *                    cols is 1, aux[0], aux[1] are the grid's rows and
+ *                    cols, and there may be no rows at all)
+ *
+ * Every row starts on a byte boundary (stride bytes apart), so a cell
+ * is addressed in place with one shift and mask.  aoc_bin_open() maps
+ * the file read-only and checks the header against the file size, which
+ * is all a load costs; aoc_bin_check() does the same for a container
+ * already in memory.  The payload checksum is only compared when asked
+ * (AOC_BIN_VERIFY, or `convert check`), since that reads every byte.
+ *
+ * The header is little-endian and written as-is, so files move between
+ * x86 and arm64 but not to big-endian hosts.  lib/convert.c writes them
+ * from the puzzle text.  Plain C and C++; functions return 1/0 like the
+ * rest of lib, with the reason in err on failure.
+ */
+
+#define AOC_BIN_MAGIC   "AOCB"
+#define AOC_BIN_VERSION 1u
+
+enum aoc_bin_kind {
+  AOC_BIN_NIBBLES = 1,
+  AOC_BIN_BITS = 2,
+  AOC_BIN_RUNS = 3,
+  AOC_BIN_POINTS = 4,
+};
+
+enum {
+  AOC_BIN_VERIFY = 1 << 0,    /* checksum the payload on open */
+  AOC_BIN_PREFAULT = 1 << 1,  /* map with MAP_POPULATE where available */
+};
+
+struct aoc_bin_hdr {
+  char magic[4];
+  uint32_t version;
+  uint32_t kind;
+  uint32_t rows;
+  uint32_t cols;
+  uint32_t stride;    /* payload bytes per row */
+  uint64_t aux[2];    /* kind-specific */
+  uint64_t size;      /* payload bytes: rows * stride */
+  uint64_t sum;       /* aoc_bin_sum() of the payload */
+  uint8_t reserved[8];
+};
+
+static_assert(sizeof(struct aoc_bin_hdr) == 64, "aoc_bin_hdr is 64 bytes");
+
+struct aoc_bin_point {
+  uint16_t row;
+  uint16_t col;
+  uint8_t freq;       /* the antenna's character */
+  uint8_t pad[3];
+};
+
+static_assert(sizeof(struct aoc_bin_point) == 8, "aoc_bin_point is 8 bytes");
+
+struct aoc_bin_map {
+  const struct aoc_bin_hdr *hdr;
+  const uint8_t *data;  /* payload, hdr->size bytes */
+  void *map;
+  size_t len;
+  const char *err;
+};
+
+/* 64-bit checksum, a word at a time: not cryptographic, catches damage */
+static inline uint64_t
+aoc_bin_sum(const void *p, size_t n)
+{
+  const uint8_t *s = (const uint8_t *)p;
+  uint64_t h = 0x9e3779b97f4a7c15u ^ n;
+  uint64_t w;
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    memcpy(&w, s + i, 8);
+    h = (h ^ w) * 0xbf58476d1ce4e5b9u;
+    h ^= h >> 31;
+  }
+  for (w = 0; i < n; i++)
+    w = w << 8 | s[i];
+  h = (h ^ w) * 0x94d049bb133111ebu;
+  return h ^ h >> 29;
+}
+
+/* payload bytes per row for a kind, 0 for an unknown kind */
+static inline uint32_t
+aoc_bin_stride(uint32_t kind, uint32_t cols)
+{
+  switch (kind) {
+  case AOC_BIN_NIBBLES:
+    return (cols + 1u) / 2u;
+  case AOC_BIN_BITS:
+    return (cols + 7u) / 8u;
+  case AOC_BIN_RUNS:
+    return cols;
+  case AOC_BIN_POINTS:
+    return cols == 1u ? (uint32_t)sizeof(struct aoc_bin_point) : 0u;
+  default:
+    return 0;
+  }
+}
+
+static inline unsigned
+aoc_bin_nibble(const uint8_t *row, size_t col)
+{
+  return (row[col >> 1] >> ((col & 1u) * 4u)) & 15u;
+}
+
+static inline unsigned
+aoc_bin_bit(const uint8_t *row, size_t col)
+{
+  return (row[col >> 3] >> (col & 7u)) & 1u;
+}
+
+/* does path start with the container magic? */
+static inline int
+aoc_bin_is(const char *path)
+{
+  char m[4];
+  int fd = open(path, O_RDONLY);
+  int ok;
+
+  if (fd < 0)
+    return 0;
+  ok = read(fd, m, 4) == 4 && memcmp(m, AOC_BIN_MAGIC, 4) == 0;
+  close(fd);
+  return ok;
+}
+
+/* validate a container of len bytes already in memory: NULL when it
+   holds a well-formed input of this kind, else the reason */
+static inline const char *
+aoc_bin_check(const void *p, size_t len, uint32_t kind, int flags)
+{
+  const struct aoc_bin_hdr *h = (const struct aoc_bin_hdr *)p;
+
+  if (len < sizeof *h)
+    return "truncated header";
+  if (memcmp(h->magic, AOC_BIN_MAGIC, 4) != 0)
+    return "not an aoc binary input";
+  if (h->version != AOC_BIN_VERSION)
+    return "unsupported version";
+  if (h->kind != kind)
+    return "wrong kind of input";
+  if ((h->rows == 0 && h->kind != AOC_BIN_POINTS) || h->cols == 0 ||
+      h->stride == 0 || h->stride != aoc_bin_stride(h->kind, h->cols) ||
+      h->size != (uint64_t)h->rows * h->stride)
+    return "bad dimensions";
+  if (h->size != len - sizeof *h)
+    return "payload size mismatch";
+  if ((flags & AOC_BIN_VERIFY) &&
+      aoc_bin_sum((const uint8_t *)p + sizeof *h, h->size) != h->sum)
+    return "checksum mismatch";
+  if (h->kind == AOC_BIN_BITS) {
+    /* S and E index straight into the expanded grid */
+    const uint8_t *data = (const uint8_t *)p + sizeof *h;
+
+    for (int i = 0; i < 2; i++) {
+      if (h->aux[i] >= (uint64_t)h->rows * h->cols)
+        return "S or E out of range";
+      if (!aoc_bin_bit(data + h->aux[i] / h->cols * h->stride,
+                       (size_t)(h->aux[i] % h->cols)))
+        return "S or E on a wall";
+    }
+  }
+  return NULL;
+}
+
+static inline void
+aoc_bin_close(struct aoc_bin_map *m)
+{
+  if (m->map)
+    munmap(m->map, m->len);
+  m->map = NULL;
+  m->hdr = NULL;
+  m->data = NULL;
+}
+
+[[nodiscard]] static inline int
+aoc_bin_open(struct aoc_bin_map *m, const char *path, uint32_t kind, int flags)
+{
+  struct stat st;
+  int mflags = MAP_PRIVATE;
+  int fd;
+
+  memset(m, 0, sizeof *m);
+  fd = open(path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    m->err = "cannot open";
+    if (fd >= 0)
+      close(fd);
+    return 0;
+  }
+  if ((size_t)st.st_size < sizeof(struct aoc_bin_hdr)) {
+    close(fd);
+    m->err = "truncated header";
+    return 0;
+  }
+#ifdef MAP_POPULATE
+  if (flags & AOC_BIN_PREFAULT)
+    mflags |= MAP_POPULATE;
+#endif
+  m->len = (size_t)st.st_size;
+  m->map = mmap(NULL, m->len, PROT_READ, mflags, fd, 0);
+  close(fd);
+  if (m->map == MAP_FAILED) {
+    m->map = NULL;
+    m->err = "cannot map";
+    return 0;
+  }
+  m->err = aoc_bin_check(m->map, m->len, kind, flags);
+  if (m->err) {
+    aoc_bin_close(m);
+    return 0;
+  }
+  m->hdr = (const struct aoc_bin_hdr *)m->map;
+  m->data = (const uint8_t *)m->map + sizeof *m->hdr;
+  return 1;
+}
+
+/* write hdr (magic, version, size and sum filled in here) and payload */
+[[nodiscard]] static inline int
+aoc_bin_write(const char *path, struct aoc_bin_hdr *hdr, const void *payload)
+{
+  FILE *f;
+  int ok;
+
+  memcpy(hdr->magic, AOC_BIN_MAGIC, 4);
+  hdr->version = AOC_BIN_VERSION;
+  hdr->stride = aoc_bin_stride(hdr->kind, hdr->cols);
+  hdr->size = (uint64_t)hdr->rows * hdr->stride;
+  hdr->sum = aoc_bin_sum(payload, hdr->size);
+  f = fopen(path, "wb");
+  if (!f)
+    return 0;
+  ok = fwrite(hdr, sizeof *hdr, 1, f) == 1 &&
+       fwrite(payload, 1, hdr->size, f) == hdr->size;
+  return fclose(f) == 0 && ok;
+}
+
+#endif /* AOC_BIN_H */
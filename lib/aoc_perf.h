@@ -0,0 +1,242 @@
+#ifndef AOC_PERF_H
+#define AOC_PERF_H
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Hardware counters around a solver phase, via perf_event_open(2).
+ *
+ *   struct aoc_perf pc;
+ *   struct aoc_perf_sample s;
+ *
+ *   aoc_perf_open(&pc, 0);
+ *   aoc_perf_start(&pc);
+ *   ... phase ...
+ *   aoc_perf_stop(&pc, &s);
+ *   aoc_perf_report(stderr, "part 2", ms, &s);
+ *   aoc_perf_close(&pc);
+ *
+ * Each event is opened on its own, user space only, so a CPU or VM that
+ * lacks one (LLC misses under many hypervisors) still reports the rest.
+ * When the kernel refuses all of them (perf_event_paranoid, seccomp, no
+ * PMU) every call is a no-op, the samples come back empty, the report
+ * prints "n/a" and aoc_perf_why() says why, so callers never need a
+ * separate code path.  Counts are scaled up when the kernel had to
+ * multiplex the PMU.
+ *
+ * AOC_PERF_INHERIT also counts threads the caller creates after
+ * aoc_perf_open(); their counts are added in as they exit.
+ *
+ * Plain C and C++; Linux only.  C callers define _GNU_SOURCE (or
+ * _DEFAULT_SOURCE) before the first system header for syscall().
+ */
+
+enum aoc_perf_event {
+  AOC_PERF_CYCLES,
+  AOC_PERF_INSTRUCTIONS,
+  AOC_PERF_L1D_MISSES,
+  AOC_PERF_LLC_MISSES,
+  AOC_PERF_BRANCH_MISSES,
+  AOC_PERF_DTLB_MISSES,
+  AOC_PERF_NEVENTS
+};
+
+enum {
+  AOC_PERF_INHERIT = 1 << 0,
+};
+
+static const char *const aoc_perf_names[AOC_PERF_NEVENTS] = {
+  "cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses",
+  "dTLB-misses",
+};
+
+struct aoc_perf {
+  int fd[AOC_PERF_NEVENTS];   /* -1 where the event could not be opened */
+  int nopen;
+  int err;                    /* errno of the first failed open */
+};
+
+struct aoc_perf_sample {
+  uint64_t v[AOC_PERF_NEVENTS];
+  unsigned valid;             /* bit e set when v[e] was counted */
+};
+
+static inline int
+aoc_perf_open_one(const struct perf_event_attr *tmpl, uint32_t type,
+                  uint64_t config)
+{
+  struct perf_event_attr pe = *tmpl;
+
+  pe.type = type;
+  pe.config = config;
+  return (int)syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+}
+
+/* open every event the kernel allows; returns how many */
+static inline int
+aoc_perf_open(struct aoc_perf *p, int flags)
+{
+  static const uint64_t cache_read_miss =
+      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  static const struct { uint32_t type; uint64_t config; } ev[AOC_PERF_NEVENTS] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cache_read_miss },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | cache_read_miss },
+  };
+  struct perf_event_attr pe;
+
+  memset(&pe, 0, sizeof pe);
+  pe.size = sizeof pe;
+  pe.disabled = 1;
+  pe.inherit = (flags & AOC_PERF_INHERIT) ? 1 : 0;
+  pe.exclude_kernel = 1;
+  pe.exclude_hv = 1;
+  pe.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  p->nopen = 0;
+  p->err = 0;
+  for (int e = 0; e < AOC_PERF_NEVENTS; e++) {
+    p->fd[e] = aoc_perf_open_one(&pe, ev[e].type, ev[e].config);
+    if (p->fd[e] >= 0)
+      p->nopen++;
+    else if (p->err == 0)
+      p->err = errno;
+  }
+  return p->nopen;
+}
+
+static inline void
+aoc_perf_close(struct aoc_perf *p)
+{
+  for (int e = 0; e < AOC_PERF_NEVENTS; e++) {
+    if (p->fd[e] >= 0)
+      close(p->fd[e]);
+    p->fd[e] = -1;
+  }
+  p->nopen = 0;
+}
+
+/* zero and enable every open counter */
+static inline void
+aoc_perf_start(struct aoc_perf *p)
+{
+  for (int e = 0; e < AOC_PERF_NEVENTS; e++) {
+    if (p->fd[e] >= 0) {
+      ioctl(p->fd[e], PERF_EVENT_IOC_RESET, 0);
+      ioctl(p->fd[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+/* disable the counters and read them into s */
+static inline void
+aoc_perf_stop(struct aoc_perf *p, struct aoc_perf_sample *s)
+{
+  memset(s, 0, sizeof *s);
+  for (int e = 0; e < AOC_PERF_NEVENTS; e++) {
+    if (p->fd[e] >= 0)
+      ioctl(p->fd[e], PERF_EVENT_IOC_DISABLE, 0);
+  }
+  for (int e = 0; e < AOC_PERF_NEVENTS; e++) {
+    uint64_t r[3];   /* value, time enabled, time running */
+
+    if (p->fd[e] < 0 || read(p->fd[e], r, sizeof r) != (ssize_t)sizeof r)
+      continue;
+    if (r[2] == 0)
+      continue;      /* never got onto the PMU */
+    s->v[e] = r[2] < r[1] ? (uint64_t)((double)r[0] * r[1] / r[2]) : r[0];
+    s->valid |= 1u << e;
+  }
+}
+
+/* monotonic clock in milliseconds, to time the same phase */
+static inline double
+aoc_perf_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+/* why nothing could be opened, for the report */
+static inline const char *
+aoc_perf_why(const struct aoc_perf *p, char *buf, size_t n)
+{
+  FILE *f;
+  int level;
+
+  if (p->nopen > 0)
+    return "";
+  switch (p->err) {
+  case EACCES:
+  case EPERM:
+    f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+    if (f && fscanf(f, "%d", &level) == 1)
+      snprintf(buf, n, "not permitted, perf_event_paranoid=%d", level);
+    else
+      snprintf(buf, n, "not permitted");
+    if (f)
+      fclose(f);
+    return buf;
+  case ENOENT:
+  case EOPNOTSUPP:
+    return "no hardware counters";
+  case ENOSYS:
+    return "no perf_event_open";
+  default:
+    snprintf(buf, n, "%s", strerror(p->err));
+    return buf;
+  }
+}
+
+static inline int
+aoc_perf_has(const struct aoc_perf_sample *s, unsigned mask)
+{
+  return (s->valid & mask) == mask;
+}
+
+/*
+ * One line per phase: time, then IPC and misses per thousand
+ * instructions for whatever was counted; "n/a" when nothing was.
+ */
+static inline void
+aoc_perf_report(FILE *out, const char *label, double ms,
+                const struct aoc_perf_sample *s)
+{
+  const unsigned ins = 1u << AOC_PERF_INSTRUCTIONS;
+  double kins = (double)s->v[AOC_PERF_INSTRUCTIONS] / 1e3;
+
+  fprintf(out, "  %-10s %9.3f ms", label, ms);
+  if (s->valid == 0) {
+    fprintf(out, "  counters n/a\n");
+    return;
+  }
+  if (aoc_perf_has(s, ins | 1u << AOC_PERF_CYCLES) && s->v[AOC_PERF_CYCLES])
+    fprintf(out, "  %6.2f IPC",
+            (double)s->v[AOC_PERF_INSTRUCTIONS] / (double)s->v[AOC_PERF_CYCLES]);
+  if (aoc_perf_has(s, ins))
+    fprintf(out, "  %8.1fM ins", kins / 1e3);
+  if (aoc_perf_has(s, ins) && kins > 0) {
+    for (int e = AOC_PERF_L1D_MISSES; e < AOC_PERF_NEVENTS; e++) {
+      if (s->valid & 1u << e)
+        fprintf(out, "  %s %.2f/ki", aoc_perf_names[e], (double)s->v[e] / kins);
+    }
+  }
+  fputc('\n', out);
+}
+
+#endif /* AOC_PERF_H */
@@ -0,0 +1,343 @@
+#ifndef AOC_QUEUE_H
+#define AOC_QUEUE_H
+
+#include <stdint.h>
+
+#include "aoc.h"
+
+/*
+ * Frontier containers for BFS and Dijkstra over dense uint32_t ids.
+ *
+ *  - aoc_fifo:  growable ring buffer, FIFO order
+ *  - aoc_iheap: indexed 4-ary min-heap with decrease-key; every id is
+ *               in the heap at most once, so pops are never stale
+ *  - aoc_rheap: radix heap for monotone keys (nothing pushed below the
+ *               last key popped); amortised O(log C) per pop
+ *
+ * Storage comes from the arena when one is given and from malloc
+ * otherwise, as with aoc_alloc().  Growing inside an arena leaves the
+ * old block behind until the arena is reset, so size arenas for the
+ * peak; with malloc the old block is freed.  Functions that allocate
+ * return 1 on success and 0 on failure.  Both heaps take and return
+ * (key, id) in that order, like struct aoc_heap_item.
+ */
+
+/* ------------------------------------------------------------------ fifo */
+
+struct aoc_fifo {
+  struct aoc_arena *a;
+  uint32_t *v;
+  size_t cap;   /* power of two */
+  size_t head;  /* slot of the front element */
+  size_t n;
+};
+
+[[nodiscard]] static inline int
+aoc_fifo_init(struct aoc_fifo *q, struct aoc_arena *a, size_t cap)
+{
+  size_t c = 16u;
+
+  if (!q)
+    return 0;
+  while (c < cap)
+    c *= 2u;
+  q->a = a;
+  q->v = aoc_new(a, uint32_t, c);
+  q->cap = q->v ? c : 0u;
+  q->head = 0u;
+  q->n = 0u;
+  return q->v != NULL;
+}
+
+static inline void
+aoc_fifo_free(struct aoc_fifo *q)
+{
+  if (!q) return;
+
+  aoc_release(q->a, q->v);
+  q->v = NULL;
+  q->cap = q->n = q->head = 0u;
+}
+
+static inline void
+aoc_fifo_clear(struct aoc_fifo *q)
+{
+  q->head = 0u;
+  q->n = 0u;
+}
+
+static inline size_t
+aoc_fifo_len(const struct aoc_fifo *q)
+{
+  return q->n;
+}
+
+[[nodiscard]] static inline int
+aoc_fifo_push(struct aoc_fifo *q, uint32_t x)
+{
+  if (q->n == q->cap) {
+    size_t cap = q->cap * 2u;
+    uint32_t *v = aoc_new(q->a, uint32_t, cap);
+    size_t first;
+
+    if (!v)
+      return 0;
+    /* unwrap: [head, cap) then [0, head) */
+    first = q->cap - q->head;
+    memcpy(v, q->v + q->head, first * sizeof *v);
+    memcpy(v + first, q->v, q->head * sizeof *v);
+    aoc_release(q->a, q->v);
+    q->v = v;
+    q->cap = cap;
+    q->head = 0u;
+  }
+  q->v[(q->head + q->n) & (q->cap - 1u)] = x;
+  q->n++;
+  return 1;
+}
+
+/* 0 when empty */
+static inline int
+aoc_fifo_pop(struct aoc_fifo *q, uint32_t *out)
+{
+  if (q->n == 0u)
+    return 0;
+  *out = q->v[q->head];
+  q->head = (q->head + 1u) & (q->cap - 1u);
+  q->n--;
+  return 1;
+}
+
+/* ----------------------------------------------------------------- iheap */
+
+#define AOC_IHEAP_NONE UINT32_MAX
+
+struct aoc_heap_item {
+  uint32_t key;
+  uint32_t id;
+};
+
+struct aoc_iheap {
+  struct aoc_arena *a;
+  struct aoc_heap_item *v;  /* 4-ary heap ordered by key */
+  uint32_t *pos;            /* slot per id, AOC_IHEAP_NONE when absent */
+  size_t n;
+  size_t ids;               /* ids are < ids */
+};
+
+[[nodiscard]] static inline int
+aoc_iheap_init(struct aoc_iheap *h, struct aoc_arena *a, size_t ids)
+{
+  if (!h || ids == 0u || ids > AOC_IHEAP_NONE)
+    return 0;
+  h->a = a;
+  h->n = 0u;
+  h->ids = ids;
+  h->v = aoc_new(a, struct aoc_heap_item, ids);
+  h->pos = aoc_new(a, uint32_t, ids);
+  if (!h->v || !h->pos) {
+    aoc_release(a, h->v);
+    aoc_release(a, h->pos);
+    return 0;
+  }
+  memset(h->pos, 0xff, ids * sizeof *h->pos);
+  return 1;
+}
+
+static inline void
+aoc_iheap_free(struct aoc_iheap *h)
+{
+  if (!h) return;
+
+  aoc_release(h->a, h->v);
+  aoc_release(h->a, h->pos);
+  h->v = NULL;
+  h->pos = NULL;
+  h->n = 0u;
+}
+
+static inline int
+aoc_iheap_empty(const struct aoc_iheap *h)
+{
+  return h->n == 0u;
+}
+
+static inline void
+aoc_iheap_up(struct aoc_iheap *h, size_t i, struct aoc_heap_item it)
+{
+  while (i > 0u) {
+    size_t p = (i - 1u) / 4u;
+    if (h->v[p].key <= it.key)
+      break;
+    h->v[i] = h->v[p];
+    h->pos[h->v[i].id] = (uint32_t)i;
+    i = p;
+  }
+  h->v[i] = it;
+  h->pos[it.id] = (uint32_t)i;
+}
+
+static inline void
+aoc_iheap_down(struct aoc_iheap *h, size_t i, struct aoc_heap_item it)
+{
+  for (;;) {
+    size_t c = 4u * i + 1u;
+    size_t end = c + 4u < h->n ? c + 4u : h->n;
+    size_t best = i;
+    uint32_t bkey = it.key;
+
+    for (; c < end; c++) {
+      if (h->v[c].key < bkey) {
+        best = c;
+        bkey = h->v[c].key;
+      }
+    }
+    if (best == i)
+      break;
+    h->v[i] = h->v[best];
+    h->pos[h->v[i].id] = (uint32_t)i;
+    i = best;
+  }
+  h->v[i] = it;
+  h->pos[it.id] = (uint32_t)i;
+}
+
+/*
+ * Insert id with key, or lower its key if already queued.  Returns 1 if
+ * the heap changed, 0 if id was already queued with a key <= key.
+ */
+static inline int
+aoc_iheap_update(struct aoc_iheap *h, uint32_t key, uint32_t id)
+{
+  uint32_t i = h->pos[id];
+  struct aoc_heap_item it = { key, id };
+
+  if (i == AOC_IHEAP_NONE) {
+    aoc_iheap_up(h, h->n++, it);
+    return 1;
+  }
+  if (h->v[i].key <= key)
+    return 0;
+  aoc_iheap_up(h, i, it);
+  return 1;
+}
+
+/* 0 when empty */
+static inline int
+aoc_iheap_pop(struct aoc_iheap *h, uint32_t *key, uint32_t *id)
+{
+  if (h->n == 0u)
+    return 0;
+  *key = h->v[0].key;
+  *id = h->v[0].id;
+  h->pos[*id] = AOC_IHEAP_NONE;
+  if (--h->n > 0u)
+    aoc_iheap_down(h, 0u, h->v[h->n]);
+  return 1;
+}
+
+/* ----------------------------------------------------------------- rheap */
+
+#define AOC_RHEAP_BUCKETS 33
+
+struct aoc_rheap {
+  struct aoc_arena *a;
+  struct aoc_heap_item *b[AOC_RHEAP_BUCKETS];
+  size_t n[AOC_RHEAP_BUCKETS];
+  size_t cap[AOC_RHEAP_BUCKETS];
+  uint32_t last;  /* last key popped */
+  size_t size;
+};
+
+/* bucket i > 0 holds keys whose highest bit differing from last is i - 1 */
+static inline size_t
+aoc_rheap_bucket(uint32_t last, uint32_t key)
+{
+  return key == last ? 0u : 32u - (size_t)__builtin_clz(key ^ last);
+}
+
+static inline void
+aoc_rheap_init(struct aoc_rheap *h, struct aoc_arena *a)
+{
+  memset(h, 0, sizeof *h);
+  h->a = a;
+}
+
+static inline void
+aoc_rheap_free(struct aoc_rheap *h)
+{
+  if (!h) return;
+
+  for (size_t i = 0u; i < AOC_RHEAP_BUCKETS; i++)
+    aoc_release(h->a, h->b[i]);
+  aoc_rheap_init(h, h->a);
+}
+
+static inline int
+aoc_rheap_empty(const struct aoc_rheap *h)
+{
+  return h->size == 0u;
+}
+
+[[nodiscard]] static inline int
+aoc_rheap_append(struct aoc_rheap *h, size_t i, struct aoc_heap_item it)
+{
+  if (h->n[i] == h->cap[i]) {
+    size_t cap = h->cap[i] ? h->cap[i] * 2u : 64u;
+    void *p = h->b[i];
+
+    if (!aoc_grow(h->a, &p, h->n[i], cap, sizeof it))
+      return 0;
+    h->b[i] = p;
+    h->cap[i] = cap;
+  }
+  h->b[i][h->n[i]++] = it;
+  return 1;
+}
+
+/* key must not be below the last key popped */
+[[nodiscard]] static inline int
+aoc_rheap_push(struct aoc_rheap *h, uint32_t key, uint32_t id)
+{
+  struct aoc_heap_item it = { key, id };
+
+  DASSERT(key >= h->last);
+  if (!aoc_rheap_append(h, aoc_rheap_bucket(h->last, key), it))
+    return 0;
+  h->size++;
+  return 1;
+}
+
+/* 0 when empty */
+static inline int
+aoc_rheap_pop(struct aoc_rheap *h, uint32_t *key, uint32_t *id)
+{
+  if (h->size == 0u)
+    return 0;
+  if (h->n[0] == 0u) {
+    size_t i = 1u;
+    uint32_t min = UINT32_MAX;
+
+    while (h->n[i] == 0u)
+      i++;
+    for (size_t k = 0u; k < h->n[i]; k++) {
+      if (h->b[i][k].key < min)
+        min = h->b[i][k].key;
+    }
+    /* every item of bucket i moves to a lower bucket */
+    h->last = min;
+    for (size_t k = 0u; k < h->n[i]; k++) {
+      struct aoc_heap_item it = h->b[i][k];
+      int ok = aoc_rheap_append(h, aoc_rheap_bucket(min, it.key), it);
+      ASSERT(ok);
+    }
+    h->n[i] = 0u;
+  }
+  struct aoc_heap_item it = h->b[0][--h->n[0]];
+  *key = it.key;
+  *id = it.id;
+  h->size--;
+  return 1;
+}
+
+#endif /* AOC_QUEUE_H */
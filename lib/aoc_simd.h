@@ -0,0 +1,475 @@
+#ifndef AOC_SIMD_H
+#define AOC_SIMD_H
+
+#include <stdint.h>
+
+#include "aoc.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AOC_SIMD_X86 1
+#else
+#define AOC_SIMD_X86 0
+#endif
+
+/*
+ * Hot kernels compiled for several ISA levels in one binary, picked at
+ * run time.
+ *
+ *   count_byte   occurrences of one byte (newline counting)
+ *   parse_uints  every maximal run of decimal digits as a uint64_t;
+ *                anything else, '-' included, separates numbers.
+ *                Stores the first cap and returns how many there were.
+ *   popcount     set bits in an array of 64-bit words
+ *   sum_u32      64-bit sum of 32-bit values (checksums)
+ *
+ * Each kernel is built as scalar C and, on x86, with SSE2, AVX2 and
+ * AVX-512 (F + BW, VPOPCNTDQ when present) through target attributes,
+ * so the Makefiles keep their generic flags.  aoc_simd() returns the
+ * table for the best level the CPU and OS support (cpuid, via
+ * __builtin_cpu_supports) on its first call.  AOC_ISA=scalar|sse2|
+ * avx2|avx512 in the environment forces a level; one above what the
+ * host supports is lowered with a warning rather than allowed to fault.
+ *
+ * Each translation unit gets its own copy, like the rest of lib.
+ */
+
+enum aoc_isa {
+  AOC_ISA_SCALAR,
+  AOC_ISA_SSE2,
+  AOC_ISA_AVX2,
+  AOC_ISA_AVX512,
+  AOC_ISA_COUNT,
+};
+
+struct aoc_kernels {
+  enum aoc_isa isa;
+  size_t (*count_byte)(const char *p, size_t n, char c);
+  size_t (*parse_uints)(const char *p, size_t n, uint64_t *out, size_t cap);
+  uint64_t (*popcount)(const uint64_t *w, size_t n);
+  uint64_t (*sum_u32)(const uint32_t *v, size_t n);
+};
+
+static const char *const aoc_isa_names[AOC_ISA_COUNT] = {
+  "scalar", "sse2", "avx2", "avx512",
+};
+
+/* ---------------------------------------------------------------- scalar */
+
+static size_t
+aoc_count_byte_scalar(const char *p, size_t n, char c)
+{
+  size_t k = 0;
+
+  for (size_t i = 0; i < n; i++)
+    k += p[i] == c;
+  return k;
+}
+
+struct aoc_parse_state {
+  uint64_t *out;
+  size_t cap;
+  size_t n;
+  uint64_t v;
+  int in;       /* inside a run of digits */
+};
+
+static inline void
+aoc_parse_emit(struct aoc_parse_state *s)
+{
+  if (s->n < s->cap)
+    s->out[s->n] = s->v;
+  s->n++;
+  s->in = 0;
+}
+
+static inline void
+aoc_parse_bytes(struct aoc_parse_state *s, const char *p, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    unsigned d = (unsigned char)p[i] - '0';
+    if (d <= 9) {
+      s->v = s->in ? s->v * 10 + d : d;
+      s->in = 1;
+    } else if (s->in) {
+      aoc_parse_emit(s);
+    }
+  }
+}
+
+/*
+ * Value of the len (1..8) digits at p, with 8 bytes readable at p: the
+ * bytes are loaded at once, the extra ones shifted out as leading zeros,
+ * and three multiplies fold digit pairs, quads and octets.
+ */
+static inline uint64_t
+aoc_parse_swar8(const char *p, unsigned len)
+{
+  uint64_t x;
+
+  memcpy(&x, p, 8);
+  x = (x - 0x3030303030303030u) << (8u * (8u - len));
+  x = (x * 10u + (x >> 8)) & 0x00ff00ff00ff00ffu;
+  x = (x * 100u + (x >> 16)) & 0x0000ffff0000ffffu;
+  return (x * 10000u + (x >> 32)) & 0xffffffffu;
+}
+
+static const uint64_t aoc_pow10[9] = {
+  1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u,
+};
+
+/*
+ * Consume width (<= 64) bytes at p whose digit positions are the set
+ * bits of mask: skip separator runs with ctz, convert digit runs up to
+ * eight at a time.  avail is how many bytes may be read from p.
+ */
+static inline void
+aoc_parse_masked(struct aoc_parse_state *s, const char *p, uint64_t mask,
+                 unsigned width, size_t avail)
+{
+  unsigned i = 0;
+
+  if (mask == 0) {
+    if (s->in)
+      aoc_parse_emit(s);
+    return;
+  }
+  while (i < width) {
+    uint64_t m = mask >> i;   /* i < width <= 64 */
+    unsigned len;
+
+    if (!s->in) {
+      if (m == 0)
+        return;
+      i += (unsigned)__builtin_ctzll(m);
+      m = mask >> i;
+      s->in = 1;
+      s->v = 0;
+    }
+    len = ~m ? (unsigned)__builtin_ctzll(~m) : 64u;
+    if (len > width - i)
+      len = width - i;
+    for (unsigned k = 0; k < len;) {
+      unsigned step = len - k < 8u ? len - k : 8u;
+      if (i + k + 8u <= avail) {
+        s->v = s->v * aoc_pow10[step] + aoc_parse_swar8(p + i + k, step);
+      } else {
+        for (unsigned j = 0; j < step; j++)
+          s->v = s->v * 10u + (unsigned)(p[i + k + j] - '0');
+      }
+      k += step;
+    }
+    i += len;
+    if (i < width)
+      aoc_parse_emit(s);
+  }
+}
+
+static size_t
+aoc_parse_uints_scalar(const char *p, size_t n, uint64_t *out, size_t cap)
+{
+  struct aoc_parse_state s = { out, cap, 0, 0, 0 };
+
+  aoc_parse_bytes(&s, p, n);
+  if (s.in)
+    aoc_parse_emit(&s);
+  return s.n;
+}
+
+static uint64_t
+aoc_popcount_scalar(const uint64_t *w, size_t n)
+{
+  uint64_t k = 0;
+
+  /* SWAR: no popcnt instruction before SSE4.2 */
+  for (size_t i = 0; i < n; i++) {
+    uint64_t x = w[i];
+    x = x - ((x >> 1) & 0x5555555555555555u);
+    x = (x & 0x3333333333333333u) + ((x >> 2) & 0x3333333333333333u);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fu;
+    k += (x * 0x0101010101010101u) >> 56;
+  }
+  return k;
+}
+
+static uint64_t
+aoc_sum_u32_scalar(const uint32_t *v, size_t n)
+{
+  uint64_t s = 0;
+
+  for (size_t i = 0; i < n; i++)
+    s += v[i];
+  return s;
+}
+
+#if AOC_SIMD_X86
+
+/* ------------------------------------------------------------------ sse2 */
+
+__attribute__((target("sse2"))) static size_t
+aoc_count_byte_sse2(const char *p, size_t n, char c)
+{
+  __m128i needle = _mm_set1_epi8(c);
+  size_t i = 0, k = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+    k += (size_t)__builtin_popcount((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, needle)));
+  }
+  return k + aoc_count_byte_scalar(p + i, n - i, c);
+}
+
+__attribute__((target("sse2"))) static inline uint64_t
+aoc_digit_mask_sse2(const char *p)
+{
+  __m128i x = _mm_loadu_si128((const __m128i *)p);
+  __m128i ge = _mm_cmpgt_epi8(x, _mm_set1_epi8('0' - 1));
+  __m128i le = _mm_cmplt_epi8(x, _mm_set1_epi8('9' + 1));
+  return (uint64_t)(unsigned)_mm_movemask_epi8(_mm_and_si128(ge, le));
+}
+
+__attribute__((target("sse2"))) static size_t
+aoc_parse_uints_sse2(const char *p, size_t n, uint64_t *out, size_t cap)
+{
+  struct aoc_parse_state s = { out, cap, 0, 0, 0 };
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16)
+    aoc_parse_masked(&s, p + i, aoc_digit_mask_sse2(p + i), 16, n - i);
+  aoc_parse_bytes(&s, p + i, n - i);
+  if (s.in)
+    aoc_parse_emit(&s);
+  return s.n;
+}
+
+__attribute__((target("sse2"))) static uint64_t
+aoc_sum_u32_sse2(const uint32_t *v, size_t n)
+{
+  __m128i acc = _mm_setzero_si128(), zero = _mm_setzero_si128();
+  uint64_t lane[2];
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(x, zero));
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(x, zero));
+  }
+  _mm_storeu_si128((__m128i *)lane, acc);
+  return lane[0] + lane[1] + aoc_sum_u32_scalar(v + i, n - i);
+}
+
+/* ------------------------------------------------------------------ avx2 */
+
+__attribute__((target("avx2,popcnt"))) static size_t
+aoc_count_byte_avx2(const char *p, size_t n, char c)
+{
+  __m256i needle = _mm256_set1_epi8(c);
+  size_t i = 0, k = 0;
+
+  for (; i + 32 <= n; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(p + i));
+    k += (size_t)__builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, needle)));
+  }
+  return k + aoc_count_byte_scalar(p + i, n - i, c);
+}
+
+__attribute__((target("avx2,bmi"))) static size_t
+aoc_parse_uints_avx2(const char *p, size_t n, uint64_t *out, size_t cap)
+{
+  struct aoc_parse_state s = { out, cap, 0, 0, 0 };
+  __m256i lo = _mm256_set1_epi8('0' - 1), hi = _mm256_set1_epi8('9' + 1);
+  size_t i = 0;
+
+  for (; i + 32 <= n; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(p + i));
+    __m256i d = _mm256_and_si256(_mm256_cmpgt_epi8(x, lo), _mm256_cmpgt_epi8(hi, x));
+    aoc_parse_masked(&s, p + i, (uint32_t)_mm256_movemask_epi8(d), 32, n - i);
+  }
+  aoc_parse_bytes(&s, p + i, n - i);
+  if (s.in)
+    aoc_parse_emit(&s);
+  return s.n;
+}
+
+/* nibble lookup + sad (Mula), 32 bytes per step */
+__attribute__((target("avx2"))) static uint64_t
+aoc_popcount_avx2(const uint64_t *w, size_t n)
+{
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0f);
+  __m256i acc = _mm256_setzero_si256();
+  uint64_t lane[4];
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(w + i));
+    __m256i c = _mm256_add_epi8(
+      _mm256_shuffle_epi8(lut, _mm256_and_si256(x, low)),
+      _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(c, _mm256_setzero_si256()));
+  }
+  _mm256_storeu_si256((__m256i *)lane, acc);
+  return lane[0] + lane[1] + lane[2] + lane[3] + aoc_popcount_scalar(w + i, n - i);
+}
+
+__attribute__((target("avx2"))) static uint64_t
+aoc_sum_u32_avx2(const uint32_t *v, size_t n)
+{
+  __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+  uint64_t lane[4];
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(v + i));
+    a0 = _mm256_add_epi64(a0, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(x)));
+    a1 = _mm256_add_epi64(a1, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(x, 1)));
+  }
+  _mm256_storeu_si256((__m256i *)lane, _mm256_add_epi64(a0, a1));
+  return lane[0] + lane[1] + lane[2] + lane[3] + aoc_sum_u32_scalar(v + i, n - i);
+}
+
+/* ---------------------------------------------------------------- avx512 */
+
+__attribute__((target("avx512f,avx512bw,popcnt"))) static size_t
+aoc_count_byte_avx512(const char *p, size_t n, char c)
+{
+  __m512i needle = _mm512_set1_epi8(c);
+  size_t i = 0, k = 0;
+
+  for (; i + 64 <= n; i += 64) {
+    __m512i x = _mm512_loadu_si512((const void *)(p + i));
+    k += (size_t)__builtin_popcountll(_mm512_cmpeq_epi8_mask(x, needle));
+  }
+  return k + aoc_count_byte_scalar(p + i, n - i, c);
+}
+
+__attribute__((target("avx512f,avx512bw,bmi"))) static size_t
+aoc_parse_uints_avx512(const char *p, size_t n, uint64_t *out, size_t cap)
+{
+  struct aoc_parse_state s = { out, cap, 0, 0, 0 };
+  __m512i zero = _mm512_set1_epi8('0'), nine = _mm512_set1_epi8(9);
+  size_t i = 0;
+
+  for (; i + 64 <= n; i += 64) {
+    __m512i x = _mm512_sub_epi8(_mm512_loadu_si512((const void *)(p + i)), zero);
+    aoc_parse_masked(&s, p + i, _mm512_cmple_epu8_mask(x, nine), 64, n - i);
+  }
+  aoc_parse_bytes(&s, p + i, n - i);
+  if (s.in)
+    aoc_parse_emit(&s);
+  return s.n;
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq"))) static uint64_t
+aoc_popcount_vpopcnt(const uint64_t *w, size_t n)
+{
+  __m512i acc = _mm512_setzero_si512();
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8)
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512((const void *)(w + i))));
+  return (uint64_t)_mm512_reduce_add_epi64(acc) + aoc_popcount_scalar(w + i, n - i);
+}
+
+__attribute__((target("avx512f"))) static uint64_t
+aoc_sum_u32_avx512(const uint32_t *v, size_t n)
+{
+  __m512i a0 = _mm512_setzero_si512(), a1 = _mm512_setzero_si512();
+  size_t i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m512i x = _mm512_loadu_si512((const void *)(v + i));
+    a0 = _mm512_add_epi64(a0, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(x)));
+    a1 = _mm512_add_epi64(a1, _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(x, 1)));
+  }
+  return (uint64_t)_mm512_reduce_add_epi64(_mm512_add_epi64(a0, a1)) +
+         aoc_sum_u32_scalar(v + i, n - i);
+}
+
+/* VPOPCNTDQ came after the first AVX-512 parts; use AVX2 without it */
+static uint64_t
+aoc_popcount_avx512(const uint64_t *w, size_t n)
+{
+  static int vpopcnt = -1;
+
+  if (vpopcnt < 0)
+    vpopcnt = __builtin_cpu_supports("avx512vpopcntdq") != 0;
+  return vpopcnt ? aoc_popcount_vpopcnt(w, n) : aoc_popcount_avx2(w, n);
+}
+
+#endif /* AOC_SIMD_X86 */
+
+/* -------------------------------------------------------------- dispatch */
+
+static const struct aoc_kernels aoc_kernel_table[AOC_ISA_COUNT] = {
+  { AOC_ISA_SCALAR, aoc_count_byte_scalar, aoc_parse_uints_scalar,
+    aoc_popcount_scalar, aoc_sum_u32_scalar },
+#if AOC_SIMD_X86
+  { AOC_ISA_SSE2, aoc_count_byte_sse2, aoc_parse_uints_sse2,
+    aoc_popcount_scalar, aoc_sum_u32_sse2 },
+  { AOC_ISA_AVX2, aoc_count_byte_avx2, aoc_parse_uints_avx2,
+    aoc_popcount_avx2, aoc_sum_u32_avx2 },
+  { AOC_ISA_AVX512, aoc_count_byte_avx512, aoc_parse_uints_avx512,
+    aoc_popcount_avx512, aoc_sum_u32_avx512 },
+#endif
+};
+
+/* best level this CPU and OS can run */
+static inline enum aoc_isa
+aoc_isa_detect(void)
+{
+#if AOC_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    return AOC_ISA_AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") &&
+      __builtin_cpu_supports("popcnt"))
+    return AOC_ISA_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return AOC_ISA_SSE2;
+#endif
+  return AOC_ISA_SCALAR;
+}
+
+/* kernels for level isa, lowered to what the host supports */
+static inline const struct aoc_kernels *
+aoc_kernels_for(enum aoc_isa isa)
+{
+  enum aoc_isa best = aoc_isa_detect();
+
+  if (isa > best)
+    isa = best;
+  return &aoc_kernel_table[isa];
+}
+
+static inline const struct aoc_kernels *
+aoc_simd(void)
+{
+  static const struct aoc_kernels *k;
+
+  if (!k) {
+    enum aoc_isa best = aoc_isa_detect(), isa = best;
+    const char *env = getenv("AOC_ISA");
+
+    if (env && *env) {
+      for (isa = 0; isa < AOC_ISA_COUNT; isa++) {
+        if (strcmp(env, aoc_isa_names[isa]) == 0)
+          break;
+      }
+      if (isa == AOC_ISA_COUNT) {
+        fprintf(stderr, "AOC_ISA=%s: unknown level, using %s\n", env,
+                aoc_isa_names[best]);
+        isa = best;
+      } else if (isa > best) {
+        fprintf(stderr, "AOC_ISA=%s: not supported here, using %s\n", env,
+                aoc_isa_names[best]);
+        isa = best;
+      }
+    }
+    k = &aoc_kernel_table[isa];
+  }
+  return k;
+}
+
+#endif /* AOC_SIMD_H */
@@ -0,0 +1,249 @@
+#ifndef AOC_TRACE_H
+#define AOC_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Timeline tracing in the Chrome trace-event format.
+ *
+ * With AOC_TRACE=file in the environment, every scope below becomes one
+ * complete ("X") event on its thread's timeline, and the whole trace is
+ * written to file as JSON at exit; open it in ui.perfetto.dev or
+ * chrome://tracing.  Without it each scope costs one atomic load.
+ *
+ *   uint64_t t = aoc_trace_begin();     C, any shape of code
+ *   ...
+ *   aoc_trace_end("part 1", t);
+ *
+ *   AOC_TRACE_SCOPE("parse") { ... }    C, a block (no break/return out)
+ *   AocTraceScope s("search");          C++, until end of scope
+ *
+ * Each thread records into its own ring of AOC_TRACE_RING events,
+ * allocated on its first event and kept until exit, so recording takes
+ * no locks; when a ring wraps the oldest events are dropped (and
+ * counted on stderr).  Events keep their name pointer until the trace
+ * is written at exit, so event names must be string literals or
+ * otherwise outlive the program.  aoc_trace_thread_name() labels the
+ * calling thread's row with a copy of its argument (up to 31 bytes);
+ * unnamed rows are "main" for the first and "thread N".
+ *
+ * Tracing switches on at the first call, which should come from the
+ * main thread before any workers start (the "read" phase, normally).
+ * Plain C and C++; C callers need _POSIX_C_SOURCE 200809L (or
+ * _GNU_SOURCE) for clock_gettime().
+ */
+
+#ifndef AOC_TRACE_RING
+#define AOC_TRACE_RING 16384u   /* events kept per thread, power of two */
+#endif
+
+#ifdef __cplusplus
+#define AOC_TRACE_TLS thread_local
+#else
+#define AOC_TRACE_TLS _Thread_local
+#endif
+
+struct aoc_trace_event {
+  const char *name;
+  uint64_t t0;   /* ns since the trace started */
+  uint64_t t1;
+};
+
+struct aoc_trace_buf {
+  struct aoc_trace_buf *next;
+  uint32_t tid;
+  char name[32];
+  uint64_t n;    /* events recorded; the last AOC_TRACE_RING are kept */
+  struct aoc_trace_event ev[AOC_TRACE_RING];
+};
+
+enum { AOC_TRACE_UNSET, AOC_TRACE_INIT, AOC_TRACE_OFF, AOC_TRACE_ON };
+
+static struct {
+  int state;
+  const char *path;
+  uint64_t epoch;
+  uint32_t ntid;
+  struct aoc_trace_buf *head;
+} aoc_trace_g;
+
+static AOC_TRACE_TLS struct aoc_trace_buf *aoc_trace_tls;
+
+static inline uint64_t
+aoc_trace_clock(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* s as a JSON string; lib/aoc_batch.h writes its records with it too */
+static inline void
+aoc_json_str(FILE *f, const char *s)
+{
+  fputc('"', f);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      fprintf(f, "\\%c", *s);
+    else if ((unsigned char)*s < 0x20)
+      fprintf(f, "\\u%04x", (unsigned char)*s);
+    else
+      fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+/* write every thread's events to $AOC_TRACE; registered with atexit */
+static inline void
+aoc_trace_dump(void)
+{
+  FILE *f = fopen(aoc_trace_g.path, "w");
+  const char *sep = "";
+  int pid = (int)getpid();
+
+  if (!f) {
+    fprintf(stderr, "AOC_TRACE: cannot write %s\n", aoc_trace_g.path);
+    return;
+  }
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (struct aoc_trace_buf *b = aoc_trace_g.head; b; b = b->next) {
+    uint64_t first = b->n > AOC_TRACE_RING ? b->n - AOC_TRACE_RING : 0;
+    char label[48];
+
+    if (b->name[0])
+      snprintf(label, sizeof label, "%s", b->name);
+    else if (b->tid == 0)
+      snprintf(label, sizeof label, "main");   /* it switched tracing on */
+    else
+      snprintf(label, sizeof label, "thread %u", b->tid);
+    fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+               "\"tid\":%u,\"args\":{\"name\":", sep, pid, b->tid);
+    aoc_json_str(f, label);
+    fprintf(f, "}}");
+    sep = ",\n";
+    if (first > 0)
+      fprintf(stderr, "AOC_TRACE: %s dropped its %llu oldest events\n",
+              label, (unsigned long long)first);
+    for (uint64_t i = first; i < b->n; i++) {
+      const struct aoc_trace_event *e = &b->ev[i & (AOC_TRACE_RING - 1u)];
+      fprintf(f, "%s{\"name\":", sep);
+      aoc_json_str(f, e->name);
+      fprintf(f, ",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+              pid, b->tid, (double)e->t0 / 1e3, (double)(e->t1 - e->t0) / 1e3);
+    }
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+}
+
+/* read AOC_TRACE once; the first caller wins, the rest wait for it */
+static inline int
+aoc_trace_init(void)
+{
+  int s = AOC_TRACE_UNSET;
+
+  if (__atomic_compare_exchange_n(&aoc_trace_g.state, &s, AOC_TRACE_INIT, 0,
+                                  __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+    const char *p = getenv("AOC_TRACE");
+
+    s = p && *p ? AOC_TRACE_ON : AOC_TRACE_OFF;
+    aoc_trace_g.path = p;
+    aoc_trace_g.epoch = aoc_trace_clock();
+    if (s == AOC_TRACE_ON)
+      atexit(aoc_trace_dump);
+    __atomic_store_n(&aoc_trace_g.state, s, __ATOMIC_RELEASE);
+    return s;
+  }
+  while (s == AOC_TRACE_INIT)
+    s = __atomic_load_n(&aoc_trace_g.state, __ATOMIC_ACQUIRE);
+  return s;
+}
+
+static inline int
+aoc_trace_on(void)
+{
+  int s = __atomic_load_n(&aoc_trace_g.state, __ATOMIC_ACQUIRE);
+
+  if (s == AOC_TRACE_UNSET || s == AOC_TRACE_INIT)
+    s = aoc_trace_init();
+  return s == AOC_TRACE_ON;
+}
+
+/* the calling thread's ring, created on first use; NULL if out of memory */
+static inline struct aoc_trace_buf *
+aoc_trace_buf(void)
+{
+  struct aoc_trace_buf *b = aoc_trace_tls;
+
+  if (b)
+    return b;
+  b = (struct aoc_trace_buf *)calloc(1, sizeof *b);
+  if (!b)
+    return NULL;
+  b->tid = __atomic_fetch_add(&aoc_trace_g.ntid, 1u, __ATOMIC_RELAXED);
+  b->next = __atomic_load_n(&aoc_trace_g.head, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&aoc_trace_g.head, &b->next, b, 1,
+                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+  aoc_trace_tls = b;
+  return b;
+}
+
+/* start of a scope: a timestamp, or 0 when tracing is off */
+static inline uint64_t
+aoc_trace_begin(void)
+{
+  if (!aoc_trace_on())
+    return 0;
+  return aoc_trace_clock() - aoc_trace_g.epoch + 1u;   /* never 0 */
+}
+
+/* end of the scope begun at t0 */
+static inline void
+aoc_trace_end(const char *name, uint64_t t0)
+{
+  struct aoc_trace_buf *b;
+  struct aoc_trace_event *e;
+
+  if (t0 == 0 || !(b = aoc_trace_buf()))
+    return;
+  e = &b->ev[b->n & (AOC_TRACE_RING - 1u)];
+  e->name = name;
+  e->t0 = t0 - 1u;
+  e->t1 = aoc_trace_clock() - aoc_trace_g.epoch;
+  b->n++;
+}
+
+/* label the calling thread's row in the viewer */
+static inline void
+aoc_trace_thread_name(const char *name)
+{
+  struct aoc_trace_buf *b;
+
+  if (!aoc_trace_on() || !(b = aoc_trace_buf()))
+    return;
+  snprintf(b->name, sizeof b->name, "%s", name);
+}
+
+#define AOC_TRACE_SCOPE(name)                                         \
+  for (uint64_t aoc_trace_t0_ = aoc_trace_begin(), aoc_trace_once_ = 1; \
+       aoc_trace_once_; aoc_trace_once_ = 0, aoc_trace_end((name), aoc_trace_t0_))
+
+#ifdef __cplusplus
+struct AocTraceScope {
+  const char *name;
+  uint64_t t0;
+
+  explicit AocTraceScope(const char *n) : name(n), t0(aoc_trace_begin()) {}
+  ~AocTraceScope() { aoc_trace_end(name, t0); }
+  AocTraceScope(const AocTraceScope &) = delete;
+  AocTraceScope &operator=(const AocTraceScope &) = delete;
+};
+#endif
+
+#endif /* AOC_TRACE_H */
@@ -0,0 +1,195 @@
+#ifndef AOC_VMEM_H
+#define AOC_VMEM_H
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "aoc.h"
+
+/*
+ * Reserve/commit arena over one virtual range.
+ *
+ * aoc_vm_init() reserves the whole range up front (PROT_NONE,
+ * MAP_NORESERVE: address space only, no memory), and allocations commit
+ * it on demand in AOC_VM_CHUNK steps, so the arena never moves and
+ * never has to be sized exactly.  Committed pages are still faulted in
+ * one by one on first touch unless asked otherwise:
+ *
+ *   AOC_VM_POPULATE  pre-fault every chunk as it is committed
+ *                    (MAP_POPULATE, or MADV_POPULATE_WRITE with huge
+ *                    pages), moving the faults out of the code that
+ *                    first writes the memory
+ *   AOC_VM_HUGE      align the range to 2 MB and madvise(MADV_HUGEPAGE)
+ *                    each chunk, so transparent huge pages back it:
+ *                    512x fewer faults and TLB entries where THP is on
+ *
+ * aoc_vm_thread() returns a per-thread arena, created on first use,
+ * for workers that want scratch memory without sharing an allocator.
+ *
+ * Functions that allocate return NULL (pointers) or 0 (status) on
+ * failure, like the rest of lib.  Linux only; define _GNU_SOURCE before
+ * the first system header for MAP_ANONYMOUS and friends.
+ */
+
+enum {
+  AOC_VM_POPULATE = 1 << 0,
+  AOC_VM_HUGE = 1 << 1,
+};
+
+#define AOC_VM_CHUNK ((size_t)2 << 20)            /* commit granularity */
+#define AOC_VM_THREAD_RESERVE ((size_t)1 << 34)   /* per-thread range */
+
+struct aoc_vm_arena {
+  unsigned char *base;  /* aligned start of the usable range */
+  void *map;            /* what mmap returned, for munmap */
+  size_t maplen;
+  size_t reserved;      /* usable bytes from base */
+  size_t committed;     /* bytes from base that are read/write */
+  size_t off;
+  int flags;
+};
+
+[[nodiscard]] static inline int
+aoc_vm_init(struct aoc_vm_arena *a, size_t reserve, int flags)
+{
+  size_t len;
+  uintptr_t p;
+
+  if (!a || reserve == 0)
+    return 0;
+  reserve = aoc_align(reserve, AOC_VM_CHUNK);
+  /* over-reserve one chunk so base can be 2 MB aligned */
+  len = reserve + ((flags & AOC_VM_HUGE) ? AOC_VM_CHUNK : 0);
+  a->map = mmap(NULL, len, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (a->map == MAP_FAILED) {
+    a->map = NULL;
+    return 0;
+  }
+  p = (uintptr_t)a->map;
+  if (flags & AOC_VM_HUGE)
+    p = (p + AOC_VM_CHUNK - 1) & ~(uintptr_t)(AOC_VM_CHUNK - 1);
+  a->base = (unsigned char *)p;
+  a->maplen = len;
+  a->reserved = reserve;
+  a->committed = 0;
+  a->off = 0;
+  a->flags = flags;
+  return 1;
+}
+
+static inline void
+aoc_vm_free(struct aoc_vm_arena *a)
+{
+  if (!a || !a->map) return;
+
+  munmap(a->map, a->maplen);
+  a->map = NULL;
+  a->base = NULL;
+  a->reserved = a->committed = a->off = 0;
+}
+
+/* make [base, base + upto) read/write, pre-faulting if asked to */
+[[nodiscard]] static inline int
+aoc_vm_commit(struct aoc_vm_arena *a, size_t upto)
+{
+  unsigned char *p;
+  size_t n;
+
+  upto = aoc_align(upto, AOC_VM_CHUNK);
+  if (upto > a->reserved)
+    return 0;
+  if (upto <= a->committed)
+    return 1;
+  p = a->base + a->committed;
+  n = upto - a->committed;
+
+  if ((a->flags & AOC_VM_POPULATE) && !(a->flags & AOC_VM_HUGE)) {
+    /* commit and fault the chunk in one call */
+    if (mmap(p, n, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_POPULATE,
+             -1, 0) == MAP_FAILED)
+      return 0;
+  } else {
+    if (mprotect(p, n, PROT_READ | PROT_WRITE) != 0)
+      return 0;
+#ifdef MADV_HUGEPAGE
+    if (a->flags & AOC_VM_HUGE)
+      (void)madvise(p, n, MADV_HUGEPAGE);  /* advisory: THP may be off */
+#endif
+    if (a->flags & AOC_VM_POPULATE) {
+      /* populate after the advice so the faults can use huge pages */
+#ifdef MADV_POPULATE_WRITE
+      if (madvise(p, n, MADV_POPULATE_WRITE) != 0)
+#endif
+      {
+        size_t pg = (size_t)sysconf(_SC_PAGESIZE);
+        for (size_t i = 0; i < n; i += pg)
+          ((volatile unsigned char *)p)[i] = 0;
+      }
+    }
+  }
+  a->committed = upto;
+  return 1;
+}
+
+[[nodiscard]] static inline void *
+aoc_vm_alloc_align(struct aoc_vm_arena *a, size_t n, size_t al)
+{
+  size_t off;
+
+  if (!a || !a->base || n == 0) return NULL;
+
+  off = aoc_align(a->off, al);
+  if (off > a->reserved || a->reserved - off < n)
+    return NULL;
+  if (off + n > a->committed && !aoc_vm_commit(a, off + n))
+    return NULL;
+  a->off = off + n;
+  return a->base + off;
+}
+
+/* alloc from the arena; aligned at least to alignof(max_align_t) */
+[[nodiscard]] static inline void *
+aoc_vm_alloc(struct aoc_vm_arena *a, size_t n)
+{
+  return aoc_vm_alloc_align(a, n, _Alignof(max_align_t));
+}
+
+/* forget every allocation; committed memory stays committed */
+static inline void
+aoc_vm_reset(struct aoc_vm_arena *a)
+{
+  if (!a) return;
+
+  a->off = 0;
+}
+
+/* helper macro for typed alloc */
+#define aoc_vm_new(arena, type, count) \
+  ((type *)aoc_vm_alloc((arena), sizeof(type) * (size_t)(count)))
+
+/*
+ * Per-thread arena, reserved on the calling thread's first call with
+ * the flags given then (later flags are ignored).  NULL if the
+ * reservation fails.  It stays mapped until the thread calls
+ * aoc_vm_thread_release(), normally at the end of a worker.
+ */
+static _Thread_local struct aoc_vm_arena aoc_vm_tls;
+
+static inline struct aoc_vm_arena *
+aoc_vm_thread(int flags)
+{
+  if (!aoc_vm_tls.map && !aoc_vm_init(&aoc_vm_tls, AOC_VM_THREAD_RESERVE, flags))
+    return NULL;
+  return &aoc_vm_tls;
+}
+
+static inline void
+aoc_vm_thread_release(void)
+{
+  aoc_vm_free(&aoc_vm_tls);
+}
+
+#endif /* AOC_VMEM_H */
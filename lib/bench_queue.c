@@ -0,0 +1,297 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <time.h>
+
+#include "aoc.h"
+#include "aoc_queue.h"
+
+/*
+ * Microbenchmarks for aoc_queue.h on synthetic grid frontiers.
+ *
+ *   bfs       BFS over an open side x side grid from the centre: the
+ *             frontier is a diamond that grows to ~2 * side cells.  The
+ *             aoc_fifo starts at 16 slots and grows; the baseline is a
+ *             flat array sized for every cell up front.
+ *   dijkstra  4-way grid with a weight per directed edge.  Weights are
+ *             uniform 1..255, or bimodal 1/1000 like day16's step/turn
+ *             costs.  A lazy binary heap that pushes a
+ *             duplicate on every improvement is the baseline, against
+ *             aoc_iheap (decrease-key, no stale pops) and aoc_rheap.
+ *
+ * usage: bench_queue [side]   (default 2000)
+ */
+
+struct lazy_heap {
+  struct aoc_heap_item *v;
+  size_t n;
+  size_t cap;
+};
+
+static void
+lazy_push(struct lazy_heap *h, uint32_t key, uint32_t id)
+{
+  size_t i;
+
+  if (h->n == h->cap) {
+    void *p = h->v;
+    h->cap = h->cap ? h->cap * 2u : 1024u;
+    ASSERT(aoc_grow(NULL, &p, h->n, h->cap, sizeof *h->v));
+    h->v = p;
+  }
+  i = h->n++;
+  while (i > 0u && h->v[(i - 1u) / 2u].key > key) {
+    h->v[i] = h->v[(i - 1u) / 2u];
+    i = (i - 1u) / 2u;
+  }
+  h->v[i].key = key;
+  h->v[i].id = id;
+}
+
+static int
+lazy_pop(struct lazy_heap *h, uint32_t *key, uint32_t *id)
+{
+  struct aoc_heap_item last;
+  size_t i = 0u;
+
+  if (h->n == 0u)
+    return 0;
+  *key = h->v[0].key;
+  *id = h->v[0].id;
+  last = h->v[--h->n];
+  for (;;) {
+    size_t c = 2u * i + 1u;
+    if (c >= h->n)
+      break;
+    if (c + 1u < h->n && h->v[c + 1u].key < h->v[c].key)
+      c++;
+    if (h->v[c].key >= last.key)
+      break;
+    h->v[i] = h->v[c];
+    i = c;
+  }
+  if (h->n > 0u)
+    h->v[i] = last;
+  return 1;
+}
+
+static double
+now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15u;
+
+static uint32_t
+rng(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return (uint32_t)(rng_state >> 16);
+}
+
+struct grid {
+  uint32_t side;
+  uint32_t n;
+  uint16_t *w;     /* 4 per cell: cost of the edge in direction k */
+  uint32_t *dist;
+};
+
+/* run body with nb set to each in-bounds 4-neighbour of id and k to
+   the index of that edge in w */
+#define EACH_NEIGHBOUR(g, id, nb, k, body)                             \
+  do {                                                                \
+    uint32_t y_ = (id) / (g)->side, x_ = (id) % (g)->side;            \
+    uint32_t nb, k;                                                   \
+    if (y_ > 0u) { nb = (id) - (g)->side; k = 4u * (id); body }       \
+    if (y_ + 1u < (g)->side) { nb = (id) + (g)->side; k = 4u * (id) + 1u; body } \
+    if (x_ > 0u) { nb = (id) - 1u; k = 4u * (id) + 2u; body }         \
+    if (x_ + 1u < (g)->side) { nb = (id) + 1u; k = 4u * (id) + 3u; body } \
+  } while (0)
+
+static uint64_t
+checksum(const struct grid *g)
+{
+  uint64_t s = 0u;
+
+  for (uint32_t i = 0u; i < g->n; i++)
+    s = s * 31u + g->dist[i];
+  return s;
+}
+
+static void
+bench_bfs(struct grid *g)
+{
+  struct aoc_fifo q;
+  uint32_t *flat = aoc_new(NULL, uint32_t, g->n);
+  uint32_t src = g->n / 2u + g->side / 2u;
+  uint32_t id;
+  size_t peak = 0u;
+  double t0, t1, t2;
+  uint64_t c1, c2;
+
+  ASSERT(flat != NULL);
+  ASSERT(aoc_fifo_init(&q, NULL, 16u));
+
+  t0 = now_ms();
+  memset(g->dist, 0xff, g->n * sizeof *g->dist);
+  g->dist[src] = 0u;
+  ASSERT(aoc_fifo_push(&q, src));
+  while (aoc_fifo_pop(&q, &id)) {
+    EACH_NEIGHBOUR(g, id, nb, k, {
+      (void)k;
+      if (g->dist[nb] == UINT32_MAX) {
+        g->dist[nb] = g->dist[id] + 1u;
+        ASSERT(aoc_fifo_push(&q, nb));
+      }
+    });
+    if (aoc_fifo_len(&q) > peak)
+      peak = aoc_fifo_len(&q);
+  }
+  t1 = now_ms();
+  c1 = checksum(g);
+
+  size_t head = 0u, tail = 0u;
+  memset(g->dist, 0xff, g->n * sizeof *g->dist);
+  g->dist[src] = 0u;
+  flat[tail++] = src;
+  while (head < tail) {
+    id = flat[head++];
+    EACH_NEIGHBOUR(g, id, nb, k, {
+      (void)k;
+      if (g->dist[nb] == UINT32_MAX) {
+        g->dist[nb] = g->dist[id] + 1u;
+        flat[tail++] = nb;
+      }
+    });
+  }
+  t2 = now_ms();
+  c2 = checksum(g);
+
+  printf("bfs %ux%u: fifo %.1f ms (peak %zu, cap %zu), flat array %.1f ms (%u slots)%s\n",
+         g->side, g->side, t1 - t0, peak, q.cap, t2 - t1, g->n,
+         c1 == c2 ? "" : "  MISMATCH");
+  aoc_fifo_free(&q);
+  free(flat);
+}
+
+static void
+relax_init(struct grid *g, uint32_t src)
+{
+  memset(g->dist, 0xff, g->n * sizeof *g->dist);
+  g->dist[src] = 0u;
+}
+
+static void
+bench_dijkstra(struct grid *g, const char *label)
+{
+  struct lazy_heap lh = { 0 };
+  struct aoc_iheap ih;
+  struct aoc_rheap rh;
+  struct aoc_arena arena;
+  uint32_t src = 0u, key, id;
+  uint64_t pops[3] = { 0 }, sums[3];
+  double ms[3], t;
+
+  /* lazy binary heap: duplicate entries, stale pops skipped */
+  t = now_ms();
+  relax_init(g, src);
+  lazy_push(&lh, 0u, src);
+  while (lazy_pop(&lh, &key, &id)) {
+    pops[0]++;
+    if (key != g->dist[id])
+      continue;
+    EACH_NEIGHBOUR(g, id, nb, k, {
+      uint32_t nk = key + g->w[k];
+      if (nk < g->dist[nb]) {
+        g->dist[nb] = nk;
+        lazy_push(&lh, nk, nb);
+      }
+    });
+  }
+  ms[0] = now_ms() - t;
+  sums[0] = checksum(g);
+  free(lh.v);
+
+  /* indexed 4-ary heap in an arena: one entry per id */
+  ASSERT(aoc_arena_init(&arena, (size_t)g->n * 12u + 64u));
+  t = now_ms();
+  ASSERT(aoc_iheap_init(&ih, &arena, g->n));
+  relax_init(g, src);
+  aoc_iheap_update(&ih, 0u, src);
+  while (aoc_iheap_pop(&ih, &key, &id)) {
+    pops[1]++;
+    EACH_NEIGHBOUR(g, id, nb, k, {
+      uint32_t nk = key + g->w[k];
+      if (nk < g->dist[nb]) {
+        g->dist[nb] = nk;
+        aoc_iheap_update(&ih, nk, nb);
+      }
+    });
+  }
+  ms[1] = now_ms() - t;
+  sums[1] = checksum(g);
+  free(arena.p);
+
+  /* radix heap: monotone keys, stale pops skipped */
+  t = now_ms();
+  aoc_rheap_init(&rh, NULL);
+  relax_init(g, src);
+  ASSERT(aoc_rheap_push(&rh, 0u, src));
+  while (aoc_rheap_pop(&rh, &key, &id)) {
+    pops[2]++;
+    if (key != g->dist[id])
+      continue;
+    EACH_NEIGHBOUR(g, id, nb, k, {
+      uint32_t nk = key + g->w[k];
+      if (nk < g->dist[nb]) {
+        g->dist[nb] = nk;
+        ASSERT(aoc_rheap_push(&rh, nk, nb));
+      }
+    });
+  }
+  ms[2] = now_ms() - t;
+  sums[2] = checksum(g);
+  aoc_rheap_free(&rh);
+
+  printf("dijkstra %ux%u %s:\n", g->side, g->side, label);
+  printf("  lazy binary heap %8.1f ms, %llu pops (%llu stale)\n", ms[0],
+         (unsigned long long)pops[0], (unsigned long long)(pops[0] - g->n));
+  printf("  aoc_iheap        %8.1f ms, %llu pops (%.2fx)\n", ms[1],
+         (unsigned long long)pops[1], ms[0] / ms[1]);
+  printf("  aoc_rheap        %8.1f ms, %llu pops (%.2fx)%s\n", ms[2],
+         (unsigned long long)pops[2], ms[0] / ms[2],
+         sums[0] == sums[1] && sums[0] == sums[2] ? "" : "  MISMATCH");
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct grid g;
+
+  g.side = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 2000u;
+  ASSERT(g.side >= 2u && g.side <= 30000u);
+  g.n = g.side * g.side;
+  g.w = aoc_new(NULL, uint16_t, 4u * (size_t)g.n);
+  g.dist = aoc_new(NULL, uint32_t, g.n);
+  ASSERT(g.w != NULL && g.dist != NULL);
+
+  bench_bfs(&g);
+
+  for (size_t i = 0u; i < 4u * (size_t)g.n; i++)
+    g.w[i] = (uint16_t)(1u + rng() % 255u);
+  bench_dijkstra(&g, "weights 1..255");
+
+  for (size_t i = 0u; i < 4u * (size_t)g.n; i++)
+    g.w[i] = rng() % 8u == 0u ? 1000u : 1u;
+  bench_dijkstra(&g, "weights 1/1000");
+
+  free(g.w);
+  free(g.dist);
+  return 0;
+}
@@ -0,0 +1,119 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <time.h>
+
+#include "aoc.h"
+#include "aoc_simd.h"
+
+/*
+ * Throughput of every aoc_simd.h kernel at every ISA level this host
+ * supports, checked against the scalar result.  The last line is the
+ * level aoc_simd() dispatches to (AOC_ISA overrides it).
+ *
+ * usage: bench_simd [MB]   (default 64)
+ */
+
+static double
+now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15u;
+
+static uint64_t
+rng(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+#define RUNS 5
+
+/* best of RUNS, in GB/s over bytes; *res gets the kernel's result */
+#define TIME(bytes, res, call)                        \
+  do {                                                \
+    double best_ = 1e30;                              \
+    for (int r_ = 0; r_ < RUNS; r_++) {               \
+      double t_ = now_ms();                           \
+      (res) = (call);                                 \
+      t_ = now_ms() - t_;                             \
+      if (t_ < best_)                                 \
+        best_ = t_;                                   \
+    }                                                 \
+    gbs = (double)(bytes) / best_ / 1e6;              \
+  } while (0)
+
+int
+main(int argc, char *argv[])
+{
+  size_t mb = argc > 1 ? strtoul(argv[1], NULL, 10) : 64u;
+  size_t bytes = mb << 20;
+  char *text = malloc(bytes);
+  uint64_t *words = malloc(bytes);
+  uint32_t *vals = malloc(bytes);
+  size_t cap = bytes / 2u;
+  uint64_t *nums = malloc(cap * sizeof *nums);
+  uint64_t *want = malloc(cap * sizeof *want);   /* scalar parse_uints */
+  uint64_t ref[4] = { 0 };
+  enum aoc_isa best = aoc_isa_detect();
+  double gbs;
+
+  ASSERT(mb >= 1u && text && words && vals && nums && want);
+
+  /* AoC-like text: numbers of 1..8 digits, spaces, newlines */
+  for (size_t i = 0; i < bytes;) {
+    uint64_t r = rng();
+    size_t len = 1u + r % 8u;
+    for (size_t k = 0; k < len && i < bytes; k++, r /= 10u)
+      text[i++] = (char)('0' + r % 10u);
+    if (i < bytes)
+      text[i++] = (rng() & 7u) ? ' ' : '\n';
+  }
+  for (size_t i = 0; i < bytes / 8u; i++)
+    words[i] = rng();
+  for (size_t i = 0; i < bytes / 4u; i++)
+    vals[i] = (uint32_t)rng();
+
+  printf("%zu MB, GB/s (best of %d):\n", mb, RUNS);
+  printf("  %-8s %12s %12s %12s %12s\n", "isa", "count_byte", "parse_uints",
+         "popcount", "sum_u32");
+  for (enum aoc_isa isa = AOC_ISA_SCALAR; isa <= best; isa++) {
+    const struct aoc_kernels *k = aoc_kernels_for(isa);
+    uint64_t res[4];
+    double g[4];
+
+    TIME(bytes, res[0], k->count_byte(text, bytes, '\n'));
+    g[0] = gbs;
+    TIME(bytes, res[1], k->parse_uints(text, bytes, nums, cap));
+    g[1] = gbs;
+    TIME(bytes, res[2], k->popcount(words, bytes / 8u));
+    g[2] = gbs;
+    TIME(bytes, res[3], k->sum_u32(vals, bytes / 4u));
+    g[3] = gbs;
+    /* counts, and every parsed value, against the scalar kernels */
+    size_t n = res[1] < cap ? (size_t)res[1] : cap;
+    if (isa == AOC_ISA_SCALAR) {
+      memcpy(ref, res, sizeof ref);
+      memcpy(want, nums, n * sizeof *nums);
+    }
+    printf("  %-8s %12.2f %12.2f %12.2f %12.2f%s\n", aoc_isa_names[isa],
+           g[0], g[1], g[2], g[3],
+           memcmp(ref, res, sizeof ref) == 0 &&
+           memcmp(want, nums, n * sizeof *nums) == 0 ? "" : "  MISMATCH");
+  }
+  printf("dispatch: %s\n", aoc_isa_names[aoc_simd()->isa]);
+
+  free(text);
+  free(words);
+  free(vals);
+  free(nums);
+  free(want);
+  return 0;
+}
@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "aoc.h"
+#include "aoc_perf.h"
+#include "aoc_vmem.h"
+
+/*
+ * Page-fault benchmark for aoc_vmem.h.
+ *
+ * Each mode runs in its own child process.  Every worker thread takes
+ * MB / threads megabytes from its allocator in 64 blocks (setup), then
+ * the timed region writes every word once and does as many random
+ * reads, the first-touch pattern of a distance array or hash map.
+ * Minor faults come from getrusage; dTLB load misses from aoc_perf.h
+ * when the kernel allows it, else "n/a".
+ *
+ *   malloc       one malloc per block
+ *   vm           aoc_vm_thread(0): reserve, commit on demand
+ *   vm+pop       AOC_VM_POPULATE: faults move into setup
+ *   vm+huge      AOC_VM_HUGE: transparent huge pages
+ *   vm+huge+pop  both
+ *
+ * usage: bench_vmem [MB] [threads]   (default 512 1)
+ */
+
+#define BLOCKS 64
+
+struct mode {
+  const char *name;
+  int vm;
+  int flags;
+};
+
+static const struct mode modes[] = {
+  { "malloc", 0, 0 },
+  { "vm", 1, 0 },
+  { "vm+pop", 1, AOC_VM_POPULATE },
+  { "vm+huge", 1, AOC_VM_HUGE },
+  { "vm+huge+pop", 1, AOC_VM_HUGE | AOC_VM_POPULATE },
+};
+
+struct job {
+  const struct mode *m;
+  size_t bytes;
+  pthread_barrier_t *bar;
+  uint64_t sum;
+};
+
+static long
+minflt(void)
+{
+  struct rusage ru;
+
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_minflt;
+}
+
+static void *
+worker(void *arg)
+{
+  struct job *j = arg;
+  size_t words = j->bytes / BLOCKS / sizeof(uint64_t);
+  uint64_t *blk[BLOCKS];
+  struct aoc_vm_arena *a = NULL;
+  uint64_t x = 0x9e3779b97f4a7c15u, sum = 0;
+
+  if (j->m->vm) {
+    a = aoc_vm_thread(j->m->flags);
+    ASSERT(a != NULL);
+  }
+  for (int b = 0; b < BLOCKS; b++) {
+    blk[b] = a ? aoc_vm_new(a, uint64_t, words) : malloc(words * sizeof(uint64_t));
+    ASSERT(blk[b] != NULL);
+  }
+  pthread_barrier_wait(j->bar);   /* setup done */
+  pthread_barrier_wait(j->bar);   /* timed region starts */
+
+  for (int b = 0; b < BLOCKS; b++) {
+    for (size_t i = 0; i < words; i++)
+      blk[b][i] = i ^ (uint64_t)b;
+  }
+  for (size_t i = 0; i < words * BLOCKS; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    sum += blk[(x >> 8) % BLOCKS][(x >> 20) % words];
+  }
+  j->sum = sum;
+
+  pthread_barrier_wait(j->bar);   /* timed region ends */
+  if (a) {
+    aoc_vm_thread_release();
+  } else {
+    for (int b = 0; b < BLOCKS; b++)
+      free(blk[b]);
+  }
+  return NULL;
+}
+
+static void
+run(const struct mode *m, size_t mb, int threads)
+{
+  pthread_t tid[threads];
+  struct job job[threads];
+  pthread_barrier_t bar;
+  struct aoc_perf pc;
+  struct aoc_perf_sample ps;
+  double t0, t1, t2;
+  long f0, f1, f2;
+
+  aoc_perf_open(&pc, AOC_PERF_INHERIT);
+  pthread_barrier_init(&bar, NULL, (unsigned)threads + 1u);
+  f0 = minflt();
+  t0 = aoc_perf_ms();
+  for (int t = 0; t < threads; t++) {
+    job[t] = (struct job){ m, (mb << 20) / (size_t)threads, &bar, 0 };
+    ASSERT(pthread_create(&tid[t], NULL, worker, &job[t]) == 0);
+  }
+  pthread_barrier_wait(&bar);
+  t1 = aoc_perf_ms();
+  f1 = minflt();
+  aoc_perf_start(&pc);
+  pthread_barrier_wait(&bar);
+  pthread_barrier_wait(&bar);
+  aoc_perf_stop(&pc, &ps);
+  t2 = aoc_perf_ms();
+  f2 = minflt();
+  for (int t = 0; t < threads; t++)
+    pthread_join(tid[t], NULL);
+
+  printf("  %-12s setup %8.1f ms %8ld faults | work %8.1f ms %8ld faults",
+         m->name, t1 - t0, f1 - f0, t2 - t1, f2 - f1);
+  if (aoc_perf_has(&ps, 1u << AOC_PERF_DTLB_MISSES))
+    printf(" %12llu dTLB misses\n",
+           (unsigned long long)ps.v[AOC_PERF_DTLB_MISSES]);
+  else
+    printf("          n/a dTLB misses\n");
+  aoc_perf_close(&pc);
+  pthread_barrier_destroy(&bar);
+}
+
+int
+main(int argc, char *argv[])
+{
+  size_t mb = argc > 1 ? strtoul(argv[1], NULL, 10) : 512u;
+  int threads = argc > 2 ? atoi(argv[2]) : 1;
+
+  ASSERT(mb >= 1u && threads >= 1 && threads <= 256);
+  printf("%zu MB, %d thread(s), %d blocks each:\n", mb, threads, BLOCKS);
+  fflush(stdout);
+  for (size_t i = 0; i < sizeof modes / sizeof modes[0]; i++) {
+    pid_t pid = fork();
+    ASSERT(pid >= 0);
+    if (pid == 0) {
+      run(&modes[i], mb, threads);
+      fflush(stdout);
+      _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+  }
+  return 0;
+}
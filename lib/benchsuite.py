@@ -0,0 +1,435 @@
+#!/usr/bin/env python3
+
+# Performance history and regression check for the C and C++ solvers.
+#
+# usage: benchsuite.py run [--runs N] [--only CASE,...] [--baseline REF]
+#                          [--profile debug|release]
+#        benchsuite.py pgo [--only CASE,...]
+#        benchsuite.py compare BASE [NEW]
+#        benchsuite.py list
+#
+# run builds day6, day8, day9, day10, day11 and day16 from the working
+# tree (make, in the given lib/profile.mk profile), generates a fixed set
+# of inputs (a small and a large one per solver, and a sparse map for
+# day6 -s; fixed seeds) under .bench/inputs, times every case N times
+# and appends one JSON line per case to .bench/history.jsonl: the suite
+# run id, git commit (and whether the tree was dirty), host fingerprint,
+# every wall time, median and MAD.  With --baseline it then compares
+# the new run against REF, as compare does, and exits like it.
+#
+# pgo trains the release profile: an instrumented build of each solver
+# runs every one of its cases once, and the release build is redone with
+# -fprofile-use.  Runs record the profile, "release+pgo" once trained, so
+# a default run and a release run of one commit compare before/after.
+#
+# Cases are timed round robin, one sample of each per pass, so that the
+# machine drifting during a run spreads over every case's samples.
+#
+# compare judges run NEW (default: the latest) against BASE.  A run is
+# "latest", "previous", a run id, or a commit prefix (its latest run).
+# Only runs with the same host fingerprint are compared.  A case has
+# regressed when its median grew by more than all three of
+#
+#   --rel    (default 10%) of the baseline median,
+#   --k      (default 3) noise scales, sqrt(s_base^2 + s_new^2 + s_hist^2)
+#            with s = 1.4826 * MAD (the standard deviation, for normal
+#            noise): the MADs of the two runs' samples, and of the medians
+#            of every run of the baseline's tree (commit, plus a hash of
+#            the diff when dirty) once there are three,
+#   --min-ms (default 0.5 ms), below which timer jitter dominates;
+#
+# and compare exits 1 if any case regressed.  Improvements are reported
+# by the same test, but never fail.  A shared VM can shift by 20-30%
+# between runs minutes apart while the samples within each run agree;
+# the first two terms cannot see that, so on such hosts run the baseline
+# commit three or more times (benchsuite.py run, at that commit) before
+# trusting a small slowdown.  .bench is local state; delete it to start
+# over.
+
+import argparse
+import hashlib
+import json
+import os
+import platform
+import random
+import statistics
+import subprocess
+import sys
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+STATE = os.path.join(ROOT, ".bench")
+HISTORY = os.path.join(STATE, "history.jsonl")
+INPUTS = os.path.join(STATE, "inputs")
+
+# --------------------------------------------------------------- inputs
+
+def gen_day6(size, seed, ring=8, decoys=0.02):
+    # the guard starts in the middle facing up and walks a clockwise
+    # square spiral, rings `ring` cells apart, out of the map: one
+    # obstacle ahead of every turn, so the walk is long but cannot loop.
+    # Decoy obstacles on a `decoys` fraction of the other cells only
+    # cost parsing.
+    grid = bytearray(b"." * (size * size))
+    path = bytearray(size * size)
+    steps = ((-1, 0), (0, 1), (1, 0), (0, -1))
+    y = x = size // 2
+    path[y * size + x] = 1
+    d = k = 0
+    while True:
+        dy, dx = steps[d]
+        for _ in range(ring * (k // 2 + 1)):
+            y, x = y + dy, x + dx
+            if not (0 <= y < size and 0 <= x < size):
+                break
+            path[y * size + x] = 1
+        else:
+            oy, ox = y + dy, x + dx
+            if 0 <= oy < size and 0 <= ox < size:
+                grid[oy * size + ox] = ord("#")
+                d, k = (d + 1) % 4, k + 1
+                continue
+        break
+    rng = random.Random(seed)
+    for _ in range(int(size * size * decoys)):
+        i = rng.randrange(size * size)
+        if not path[i] and grid[i] == ord("."):
+            grid[i] = ord("#")
+    grid[(size // 2) * size + size // 2] = ord("^")
+    return b"".join(bytes(grid[r * size:(r + 1) * size]) + b"\n" for r in range(size))
+
+def gen_day8(size, seed, antennas):
+    rng = random.Random(seed)
+    grid = [bytearray(b"." * size) for _ in range(size)]
+    freqs = b"0123456789abcdefABCDEF"
+    for _ in range(antennas):
+        grid[rng.randrange(size)][rng.randrange(size)] = rng.choice(freqs)
+    return b"".join(bytes(row) + b"\n" for row in grid)
+
+def gen_day9(length, seed):
+    rng = random.Random(seed)
+    digits = [str(rng.randrange(1, 10) if i % 2 == 0 else rng.randrange(10))
+              for i in range(length)]
+    return ("".join(digits) + "\n").encode()
+
+def gen_day10(size, seed):
+    # a ramp (x + y) % 10 with a tenth of the cells scrambled, so there
+    # are many trailheads and trails but not a perfect lattice
+    rng = random.Random(seed)
+    rows = []
+    for y in range(size):
+        row = bytearray((x + y) % 10 + 48 for x in range(size))
+        for _ in range(size // 10):
+            row[rng.randrange(size)] = rng.randrange(10) + 48
+        rows.append(bytes(row) + b"\n")
+    return b"".join(rows)
+
+def gen_day11(count, seed):
+    rng = random.Random(seed)
+    return (" ".join(str(rng.randrange(10 ** 7)) for _ in range(count)) + "\n").encode()
+
+def gen_day16(size, seed):
+    return subprocess.run([sys.executable, os.path.join(ROOT, "day16", "gen.py"),
+                           str(size), str(seed)],
+                          check=True, stdout=subprocess.PIPE).stdout
+
+# name -> (solver, input generator, argv after the binary; {in} is the
+# input path, and day9 reads input.txt from its working directory)
+CASES = {
+    "day6-130":     ("day6", lambda: gen_day6(130, 6), ["{in}"]),
+    "day6-4000":    ("day6", lambda: gen_day6(4000, 6), ["{in}"]),
+    "day6-8000s":   ("day6", lambda: gen_day6(8000, 6, 16, 0.00005), ["-s", "{in}"]),
+    "day8-50":      ("day8", lambda: gen_day8(50, 8, 200), ["<{in}"]),
+    "day8-256":     ("day8", lambda: gen_day8(256, 8, 4000), ["<{in}"]),
+    "day9-20k":     ("day9", lambda: gen_day9(20000, 9), []),
+    "day9-40k":     ("day9", lambda: gen_day9(40000, 9), []),
+    "day10-60":     ("day10", lambda: gen_day10(60, 10), ["{in}"]),
+    "day10-2000":   ("day10", lambda: gen_day10(2000, 10), ["{in}"]),
+    "day11-75":     ("day11", lambda: gen_day11(8, 11), ["{in}"]),
+    "day11-5000":   ("day11", lambda: gen_day11(8, 11), ["-k", "5000", "-M", "1000000007", "{in}"]),
+    "day16-141":    ("day16", lambda: gen_day16(141, 16), ["--input", "{in}"]),
+    "day16-1001":   ("day16", lambda: gen_day16(1001, 16), ["--input", "{in}"]),
+}
+
+def input_path(case):
+    d = os.path.join(INPUTS, case)
+    path = os.path.join(d, "input.txt")
+    if not os.path.exists(path):
+        os.makedirs(d, exist_ok=True)
+        with open(path + ".tmp", "wb") as f:
+            f.write(CASES[case][1]())
+        os.rename(path + ".tmp", path)
+    return path
+
+# ---------------------------------------------------------------- build
+
+def solvers_of(cases):
+    return list(dict.fromkeys(CASES[c][0] for c in cases))
+
+def build(solver, profile="", pgo=None):
+    # make PROFILE=... (lib/profile.mk); returns the binary and a label
+    # for the flags it was built with: the profile, "+pgo" when trained
+    d = os.path.join(ROOT, solver)
+    argv = ["make", "-s", "-C", d, "PROFILE=" + profile]
+    if pgo:
+        argv.append("PGO=" + pgo)
+    subprocess.run(argv, check=True)
+    out = os.path.join(d, profile)
+    with open(os.path.join(out, ".flags")) as f:
+        trained = "-fprofile-use" in f.read()
+    return os.path.join(out, "main"), (profile or "default") + ("+pgo" if trained else "")
+
+# ------------------------------------------------------------- metadata
+
+def git(*args):
+    r = subprocess.run(["git", "-C", ROOT] + list(args), stdout=subprocess.PIPE,
+                       stderr=subprocess.DEVNULL, text=True)
+    return r.stdout.strip() if r.returncode == 0 else ""
+
+def host_info():
+    cpu = ""
+    try:
+        with open("/proc/cpuinfo") as f:
+            for line in f:
+                if line.startswith("model name"):
+                    cpu = line.split(":", 1)[1].strip()
+                    break
+    except OSError:
+        pass
+    cc = subprocess.run([os.environ.get("CC", "cc"), "--version"], stdout=subprocess.PIPE,
+                        stderr=subprocess.DEVNULL, text=True).stdout.split("\n")[0]
+    info = {
+        "node": platform.node(),
+        "cpu": cpu or platform.processor(),
+        "ncpu": os.cpu_count(),
+        "kernel": platform.release(),
+        "cc": cc,
+    }
+    info["id"] = hashlib.sha1(json.dumps(info, sort_keys=True).encode()).hexdigest()[:12]
+    return info
+
+# ---------------------------------------------------------------- stats
+
+def mad(xs):
+    m = statistics.median(xs)
+    return statistics.median(abs(x - m) for x in xs)
+
+def command(binary, case):
+    # argv, stdin path and working directory for one timed run
+    path = input_path(case)
+    stdin = None
+    args = [binary]
+    for a in CASES[case][2]:
+        if a == "<{in}":
+            stdin = path
+        else:
+            args.append(a.replace("{in}", path))
+    return args, stdin, os.path.dirname(path)
+
+def time_once(case, cmd):
+    args, stdin, cwd = cmd
+    with open(stdin or os.devnull, "rb") as f:
+        t0 = time.perf_counter()
+        r = subprocess.run(args, stdin=f, stdout=subprocess.DEVNULL,
+                           stderr=subprocess.PIPE, cwd=cwd)
+        t1 = time.perf_counter()
+    if r.returncode != 0:
+        sys.exit("%s: %s exited %d: %s" % (case, CASES[case][0], r.returncode,
+                                            r.stderr.decode(errors="replace").strip()))
+    return (t1 - t0) * 1e3
+
+def time_cases(cmds, runs):
+    # round robin: pass i times every case once, so a slow patch of the
+    # machine lands in one sample of each case instead of all samples of
+    # one, and shows in that case's MAD.  Pass 0 only warms the caches.
+    times = {case: [] for case in cmds}
+    for i in range(runs + 1):
+        for case, cmd in cmds.items():
+            t = time_once(case, cmd)
+            if i > 0:
+                times[case].append(t)
+        if sys.stderr.isatty():
+            print("  pass %d/%d" % (i, runs), end="\r", file=sys.stderr, flush=True)
+    if sys.stderr.isatty():
+        print(file=sys.stderr)
+    return times
+
+# -------------------------------------------------------------- history
+
+def load_history():
+    if not os.path.exists(HISTORY):
+        return []
+    with open(HISTORY) as f:
+        return [json.loads(line) for line in f if line.strip()]
+
+def runs_by_id(history):
+    runs = {}
+    for rec in history:
+        runs.setdefault(rec["run"], []).append(rec)
+    return runs
+
+def select_run(history, spec, host, exclude=None):
+    # run ids are timestamps, so sorting them orders runs in time
+    ids = sorted(rid for rid, recs in runs_by_id(history).items()
+                 if recs[0]["host"]["id"] == host and rid != exclude)
+    if not ids:
+        return None
+    if spec == "latest":
+        return ids[-1]
+    if spec == "previous":
+        return ids[-1] if exclude else (ids[-2] if len(ids) > 1 else None)
+    if spec in ids:
+        return spec
+    for rid in reversed(ids):
+        rec = runs_by_id(history)[rid][0]
+        if rec["commit"].startswith(spec):
+            return rid
+    return None
+
+def spread(history, base, new_id):
+    # run-to-run spread of one case: 1.4826 * MAD of the medians of every
+    # run of the baseline's exact tree on this host (the new run left
+    # out), or 0 until there are three of them
+    meds = [r["median"] for r in history
+            if r["case"] == base["case"] and r.get("tree") == base.get("tree")
+            and r.get("profile") == base.get("profile")
+            and r["host"]["id"] == base["host"]["id"]
+            and r["run"] != new_id]
+    return 1.4826 * mad(meds) if len(meds) >= 3 else 0.0
+
+def compare(history, base_id, new_id, args):
+    runs = runs_by_id(history)
+    base = {r["case"]: r for r in runs[base_id]}
+    new = {r["case"]: r for r in runs[new_id]}
+    def label(recs):
+        r = next(iter(recs.values()))
+        profiles = sorted(set(r.get("profile", "default") for r in recs.values()))
+        return "%s, %s" % (r["commit"][:10], "/".join(profiles))
+    print("%s (%s) -> %s (%s)" % (base_id, label(base), new_id, label(new)))
+    print("  %-12s %10s %10s %8s %9s  %s" % ("case", "base ms", "new ms", "change",
+                                             "noise ms", "verdict"))
+    failed = 0
+    for case in sorted(new, key=lambda c: list(CASES).index(c) if c in CASES else 0):
+        if case not in base:
+            print("  %-12s %10s %10.2f %8s %9s  new case" % (case, "-", new[case]["median"], "", ""))
+            continue
+        b, n = base[case], new[case]
+        delta = n["median"] - b["median"]
+        s_run = 1.4826 * (b["mad"] ** 2 + n["mad"] ** 2) ** 0.5
+        noise = args.k * (s_run ** 2 + spread(history, b, new_id) ** 2) ** 0.5
+        limit = max(noise, args.rel / 100 * b["median"], args.min_ms)
+        verdict = "ok"
+        if delta > limit:
+            verdict = "REGRESSION"
+            failed += 1
+        elif -delta > limit:
+            verdict = "faster"
+        print("  %-12s %10.2f %10.2f %+7.1f%% %9.2f  %s" % (
+            case, b["median"], n["median"], 100 * delta / b["median"], noise, verdict))
+    if failed:
+        print("%d case(s) slower than the baseline beyond noise" % failed)
+    return 1 if failed else 0
+
+# ------------------------------------------------------------- commands
+
+def cmd_run(args):
+    cases = args.only.split(",") if args.only else list(CASES)
+    for c in cases:
+        if c not in CASES:
+            sys.exit("unknown case %s (have: %s)" % (c, ", ".join(CASES)))
+    host = host_info()
+    commit = git("rev-parse", "HEAD") or "unknown"
+    dirty = bool(git("status", "--porcelain", "--untracked-files=no"))
+    # the commit, plus a hash of the uncommitted diff when dirty: runs of
+    # the same tree are repeats, whatever the commit says
+    tree = commit
+    if dirty:
+        tree += "+" + hashlib.sha1(git("diff", "HEAD").encode()).hexdigest()[:8]
+    now = time.time()
+    rid = time.strftime("%Y%m%dT%H%M%S", time.localtime(now)) + ".%03d" % (now % 1 * 1000)
+    builds = {solver: build(solver, args.profile) for solver in solvers_of(cases)}
+    cmds = {case: command(builds[CASES[case][0]][0], case) for case in cases}
+    recs = []
+    for case, times in time_cases(cmds, args.runs).items():
+        rec = {
+            "run": rid, "case": case, "commit": commit, "dirty": dirty, "tree": tree,
+            "profile": builds[CASES[case][0]][1],
+            "host": host, "runs": [round(t, 3) for t in times],
+            "median": round(statistics.median(times), 3), "mad": round(mad(times), 3),
+        }
+        recs.append(rec)
+        print("  %-12s median %9.2f ms  mad %7.2f ms  (%d runs)" % (
+            case, rec["median"], rec["mad"], len(times)))
+    os.makedirs(STATE, exist_ok=True)
+    with open(HISTORY, "a") as f:
+        for rec in recs:
+            f.write(json.dumps(rec) + "\n")
+    print("run %s at %s%s, host %s" % (rid, commit[:10], " (dirty)" if dirty else "", host["id"]))
+    if not args.baseline:
+        return 0
+    history = load_history()
+    base = select_run(history, args.baseline, host["id"], exclude=rid)
+    if not base:
+        print("no baseline %s on this host; nothing to compare" % args.baseline)
+        return 0
+    return compare(history, base, rid, args)
+
+def cmd_pgo(args):
+    cases = args.only.split(",") if args.only else list(CASES)
+    for solver in solvers_of(cases):
+        # a fresh profile: counters from older code would only be
+        # discarded as mismatched, or worse, merged
+        pgo_dir = os.path.join(ROOT, solver, "release", "pgo")
+        if os.path.isdir(pgo_dir):
+            for name in os.listdir(pgo_dir):
+                os.remove(os.path.join(pgo_dir, name))
+        binary, _ = build(solver, "release", "generate")
+        for case in cases:
+            if CASES[case][0] == solver:
+                time_once(case, command(binary, case))
+        _, label = build(solver, "release")
+        print("  %-6s %s" % (solver, label))
+    return 0
+
+def cmd_compare(args):
+    history = load_history()
+    host = host_info()["id"]
+    new = select_run(history, args.new, host)
+    base = select_run(history, args.base, host, exclude=new) if new else None
+    if not new or not base:
+        sys.exit("no such run on this host (see: benchsuite.py list)")
+    return compare(history, base, new, args)
+
+def cmd_list(args):
+    host = host_info()["id"]
+    for rid, recs in sorted(runs_by_id(load_history()).items()):
+        r = recs[0]
+        print("%s  %s%s  %-12s  host %s%s  %d cases" % (
+            rid, r["commit"][:10], "+" if r["dirty"] else " ", r.get("profile", "default"),
+            r["host"]["id"], "" if r["host"]["id"] == host else " (other host)", len(recs)))
+    return 0
+
+def main():
+    p = argparse.ArgumentParser(description="solver performance history")
+    sub = p.add_subparsers(dest="cmd", required=True)
+    for name in ("run", "compare"):
+        s = sub.add_parser(name)
+        s.add_argument("--rel", type=float, default=10.0)
+        s.add_argument("--k", type=float, default=3.0)
+        s.add_argument("--min-ms", type=float, default=0.5)
+        if name == "run":
+            s.add_argument("--runs", type=int, default=7)
+            s.add_argument("--only")
+            s.add_argument("--baseline")
+            s.add_argument("--profile", default="", choices=("", "debug", "release"))
+        else:
+            s.add_argument("base")
+            s.add_argument("new", nargs="?", default="latest")
+    sub.add_parser("pgo").add_argument("--only")
+    sub.add_parser("list")
+    args = p.parse_args()
+    return {"run": cmd_run, "pgo": cmd_pgo, "compare": cmd_compare,
+            "list": cmd_list}[args.cmd](args)
+
+if __name__ == "__main__":
+    sys.exit(main())
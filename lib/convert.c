@@ -0,0 +1,297 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+
+#include "aoc.h"
+#include "aoc_bin.h"
+
+/*
+ * Text puzzle inputs to the aoc_bin.h container, validated once here so
+ * the solvers can map the result and skip parsing.
+ *
+ *   convert topo IN OUT   day10 height map, digits 0-9 -> AOC_BIN_NIBBLES
+ *   convert maze IN OUT   day16 maze, '#' walls, S, E  -> AOC_BIN_BITS
+ *   convert runs IN OUT   day9 disk map, digits 0-9    -> AOC_BIN_RUNS
+ *   convert points IN OUT day8 antenna grid, '.' empty -> AOC_BIN_POINTS
+ *   convert check FILE    verify header and checksum, print the shape
+ */
+
+struct grid_text {
+  char *p;        /* the whole file, NUL-terminated */
+  uint32_t rows;
+  uint32_t cols;
+};
+
+/* count rows and check they are all as wide as the first; a CR
+   becomes an empty row, which is skipped like blank lines are */
+static int
+scan_rows(struct grid_text *g)
+{
+  uint64_t rows = 0u, cols = 0u;
+  char *s = g->p;
+
+  for (char *c = s; (c = strchr(c, '\r')) != NULL; c++)
+    *c = '\n';
+  while (*s) {
+    char *e = strchr(s, '\n');
+    size_t n = e ? (size_t)(e - s) : strlen(s);
+
+    if (n > 0u) {
+      if (rows == 0u)
+        cols = n;
+      else if (n != cols)
+        return 0;
+      rows++;
+    }
+    s += n + (e ? 1u : 0u);
+  }
+  if (rows == 0u || rows > UINT32_MAX || cols > UINT32_MAX)
+    return 0;
+  g->rows = (uint32_t)rows;
+  g->cols = (uint32_t)cols;
+  return 1;
+}
+
+/* the next non-empty row at *s, advancing *s past it */
+static const char *
+next_row(char **s)
+{
+  while (**s == '\n')
+    (*s)++;
+  const char *row = *s;
+  char *e = strchr(*s, '\n');
+  *s = e ? e + 1 : *s + strlen(*s);
+  return row;
+}
+
+static int
+convert_topo(struct grid_text *g, struct aoc_bin_hdr *h, uint8_t **out)
+{
+  uint32_t stride = aoc_bin_stride(AOC_BIN_NIBBLES, g->cols);
+  uint8_t *p = calloc((size_t)g->rows, stride);
+  char *s = g->p;
+
+  if (!p)
+    return 0;
+  for (uint32_t y = 0u; y < g->rows; y++) {
+    const char *row = next_row(&s);
+    uint8_t *dst = p + (size_t)y * stride;
+
+    for (uint32_t x = 0u; x < g->cols; x++) {
+      if (row[x] < '0' || row[x] > '9') {
+        fprintf(stderr, "convert: bad height '%c' at %u,%u\n", row[x], y, x);
+        free(p);
+        return 0;
+      }
+      dst[x >> 1] |= (uint8_t)((row[x] - '0') << ((x & 1u) * 4u));
+    }
+  }
+  h->kind = AOC_BIN_NIBBLES;
+  *out = p;
+  return 1;
+}
+
+static int
+convert_maze(struct grid_text *g, struct aoc_bin_hdr *h, uint8_t **out)
+{
+  uint32_t stride = aoc_bin_stride(AOC_BIN_BITS, g->cols);
+  uint8_t *p = calloc((size_t)g->rows, stride);
+  uint64_t start = UINT64_MAX, end = UINT64_MAX;
+  char *s = g->p;
+
+  if (!p)
+    return 0;
+  for (uint32_t y = 0u; y < g->rows; y++) {
+    const char *row = next_row(&s);
+    uint8_t *dst = p + (size_t)y * stride;
+
+    for (uint32_t x = 0u; x < g->cols; x++) {
+      uint64_t cell = (uint64_t)y * g->cols + x;
+
+      if (row[x] != '#')
+        dst[x >> 3] |= (uint8_t)(1u << (x & 7u));
+      if (row[x] == 'S')
+        start = cell;
+      else if (row[x] == 'E')
+        end = cell;
+    }
+  }
+  if (start == UINT64_MAX || end == UINT64_MAX) {
+    fprintf(stderr, "convert: maze has no S or no E\n");
+    free(p);
+    return 0;
+  }
+  h->kind = AOC_BIN_BITS;
+  h->aux[0] = start;
+  h->aux[1] = end;
+  *out = p;
+  return 1;
+}
+
+/* the single row of digits as file/free pairs, a byte each */
+static int
+convert_runs(struct grid_text *g, struct aoc_bin_hdr *h, uint8_t **out)
+{
+  uint32_t files = g->cols / 2u + g->cols % 2u;
+  uint64_t blocks = 0u;
+  char *s = g->p;
+  const char *row = next_row(&s);
+  uint8_t *p;
+
+  if (g->rows != 1u) {
+    fprintf(stderr, "convert: a disk map is one line, not %u\n", g->rows);
+    return 0;
+  }
+  p = calloc(files, 1u);
+  if (!p)
+    return 0;
+  for (uint32_t i = 0u; i < g->cols; i++) {
+    if (row[i] < '0' || row[i] > '9') {
+      fprintf(stderr, "convert: bad digit '%c' at %u\n", row[i], i);
+      free(p);
+      return 0;
+    }
+    p[i >> 1] |= (uint8_t)((row[i] - '0') << ((i & 1u) * 4u));
+    blocks += (uint64_t)(row[i] - '0');
+  }
+  h->kind = AOC_BIN_RUNS;
+  h->rows = 1u;
+  h->cols = files;
+  h->aux[0] = blocks;
+  *out = p;
+  return 1;
+}
+
+/* every non-'.' cell, stably bucketed by frequency so the grid's
+   row-major order holds within each one */
+static int
+convert_points(struct grid_text *g, struct aoc_bin_hdr *h, uint8_t **out)
+{
+  size_t count[257] = { 0 };
+  struct aoc_bin_point *pts, *sorted;
+  size_t n = 0u;
+  char *s = g->p;
+
+  if (g->rows > UINT16_MAX || g->cols > UINT16_MAX) {
+    fprintf(stderr, "convert: %ux%u is too large for 16-bit coordinates\n",
+            g->rows, g->cols);
+    return 0;
+  }
+  pts = calloc((size_t)g->rows * g->cols, sizeof *pts);
+  if (!pts)
+    return 0;
+  for (uint32_t y = 0u; y < g->rows; y++) {
+    const char *row = next_row(&s);
+
+    for (uint32_t x = 0u; x < g->cols; x++) {
+      if (row[x] == '.')
+        continue;
+      pts[n].row = (uint16_t)y;
+      pts[n].col = (uint16_t)x;
+      pts[n].freq = (uint8_t)row[x];
+      count[pts[n].freq + 1u]++;
+      n++;
+    }
+  }
+  for (size_t f = 1u; f < 257u; f++)
+    count[f] += count[f - 1u];
+  sorted = calloc(n ? n : 1u, sizeof *sorted);
+  if (!sorted) {
+    free(pts);
+    return 0;
+  }
+  for (size_t i = 0u; i < n; i++)
+    sorted[count[pts[i].freq]++] = pts[i];
+  free(pts);
+  h->kind = AOC_BIN_POINTS;
+  h->rows = (uint32_t)n;
+  h->cols = 1u;
+  h->aux[0] = g->rows;
+  h->aux[1] = g->cols;
+  *out = (uint8_t *)sorted;
+  return 1;
+}
+
+static int
+check_file(const char *path)
+{
+  static const struct {
+    uint32_t kind;
+    const char *name;
+  } kinds[] = {
+    { AOC_BIN_NIBBLES, "topo" },
+    { AOC_BIN_BITS, "maze" },
+    { AOC_BIN_RUNS, "runs" },
+    { AOC_BIN_POINTS, "points" },
+  };
+  struct aoc_bin_map m;
+
+  for (size_t i = 0u; i < sizeof kinds / sizeof kinds[0]; i++) {
+    if (aoc_bin_open(&m, path, kinds[i].kind, AOC_BIN_VERIFY)) {
+      printf("%s: %s %ux%u, %llu payload bytes, checksum ok\n", path,
+             kinds[i].name, m.hdr->rows, m.hdr->cols,
+             (unsigned long long)m.hdr->size);
+      aoc_bin_close(&m);
+      return 1;
+    }
+    if (strcmp(m.err, "wrong kind of input") != 0)
+      break;
+  }
+  fprintf(stderr, "%s: %s\n", path, m.err);
+  return 0;
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: convert topo|maze|runs|points IN OUT\n"
+                  "       convert check FILE\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct aoc_bin_hdr h;
+  struct grid_text g;
+  struct aoc_buf buf;
+  uint8_t *payload = NULL;
+  int ok = 0;
+
+  if (argc == 3 && strcmp(argv[1], "check") == 0)
+    return check_file(argv[2]) ? 0 : 1;
+  if (argc != 4)
+    usage();
+
+  if (!read_file(argv[2], NULL, &buf)) {
+    fprintf(stderr, "convert: cannot read %s\n", argv[2]);
+    return 1;
+  }
+  g.p = buf.p;
+  if (!scan_rows(&g)) {
+    fprintf(stderr, "convert: %s is empty or not rectangular\n", argv[2]);
+    return 1;
+  }
+  memset(&h, 0, sizeof h);
+  h.rows = g.rows;
+  h.cols = g.cols;
+  if (strcmp(argv[1], "topo") == 0)
+    ok = convert_topo(&g, &h, &payload);
+  else if (strcmp(argv[1], "maze") == 0)
+    ok = convert_maze(&g, &h, &payload);
+  else if (strcmp(argv[1], "runs") == 0)
+    ok = convert_runs(&g, &h, &payload);
+  else if (strcmp(argv[1], "points") == 0)
+    ok = convert_points(&g, &h, &payload);
+  else
+    usage();
+  if (!ok)
+    return 1;
+  if (!aoc_bin_write(argv[3], &h, payload)) {
+    fprintf(stderr, "convert: cannot write %s\n", argv[3]);
+    return 1;
+  }
+  free(payload);
+  free(buf.p);
+  return 0;
+}
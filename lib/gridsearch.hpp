@@ -0,0 +1,321 @@
+#ifndef GRIDSEARCH_HPP
+#define GRIDSEARCH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <limits>
+#include <queue>
+#include <vector>
+
+/*
+ * Header-only shortest-path searches over grid-like state graphs.
+ *
+ * A search is put together at compile time from four parts:
+ *
+ *   encoding   how a (cell, heading) state packs into a 32-bit id
+ *              (PackedHeading: cell * 4 + heading)
+ *   costs      the edge-cost policy (MoveTurnCost<Move, Turn>)
+ *   graph      the neighbour generator: states() bounds the ids,
+ *              max_edge() bounds one edge cost, and
+ *              each<Dir::forward>(id, f) calls f(next, cost) for every
+ *              successor, each<Dir::reverse>(id, f) for every
+ *              predecessor.  HeadingMoves<Grid, Encoding, Costs> is the
+ *              "step ahead or turn 90 degrees" graph over a padded grid
+ *              with open[] and step[4].
+ *   queue      HeapQueue (lazy deletion), IndexedHeap (decrease-key),
+ *              BucketQueue<Span> (Dial) or ZeroOneQueue
+ *
+ * search<Dir, Queue>(graph, sources) is the one Dijkstra loop; forward
+ * and reverse searches are the same template with the direction folded
+ * in as a constant, and when the costs are constexpr every relax is as
+ * tight as a hand-written loop.
+ *
+ * Distances are 32-bit; INF marks unreached states.  A settled state
+ * whose successors could wrap around stops the program, like ASSERT.
+ */
+namespace gridsearch {
+
+inline constexpr uint32_t INF = std::numeric_limits<uint32_t>::max();
+
+using DistArray = std::vector<uint32_t>;
+
+struct Node {
+    uint32_t dist;
+    uint32_t id;
+};
+
+enum class Dir { forward, reverse };
+
+// ---------------------------------------------------------------- encoding
+
+// State id = cell * 4 + heading, headings 0..3 clockwise from north.
+struct PackedHeading {
+    static constexpr uint32_t headings = 4;
+
+    static constexpr uint32_t id(uint32_t cell, uint32_t h) { return cell * 4 + h; }
+    static constexpr uint32_t cell(uint32_t id) { return id >> 2; }
+    static constexpr uint32_t heading(uint32_t id) { return id & 3; }
+    static constexpr uint32_t left(uint32_t id) { return (id & ~3u) | ((id + 3) & 3); }
+    static constexpr uint32_t right(uint32_t id) { return (id & ~3u) | ((id + 1) & 3); }
+};
+
+// ------------------------------------------------------------------ costs
+
+template <uint32_t Move, uint32_t Turn>
+struct MoveTurnCost {
+    static constexpr uint32_t move = Move;
+    static constexpr uint32_t turn = Turn;
+    static constexpr uint32_t max_edge = std::max(Move, Turn);
+};
+
+// ------------------------------------------------------------------ graphs
+
+// Step one cell ahead (if open) or turn 90 degrees in place.  Turns are
+// symmetric, so only the step differs between the two directions.
+template <class Grid, class Encoding, class Costs>
+struct HeadingMoves {
+    const Grid &grid;
+
+    explicit HeadingMoves(const Grid &g) : grid(g) {}
+
+    size_t states() const { return grid.cells() * Encoding::headings; }
+    static constexpr uint32_t max_edge() { return Costs::max_edge; }
+
+    template <Dir D, class F>
+    void each(uint32_t id, F &&f) const {
+        uint32_t p = Encoding::cell(id);
+        uint32_t h = Encoding::heading(id);
+        uint32_t q = D == Dir::forward ? p + grid.step[h] : p - grid.step[h];
+        if (grid.open[q]) {
+            f(Encoding::id(q, h), Costs::move);
+        }
+        f(Encoding::left(id), Costs::turn);
+        f(Encoding::right(id), Costs::turn);
+    }
+};
+
+// ------------------------------------------------------------------ queues
+
+// Lazy-deletion binary heap over (dist, id) packed into one 64-bit key.
+struct HeapQueue {
+    static constexpr uint32_t span = INF; // any edge cost
+
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> pq;
+
+    void push(uint32_t dist, uint32_t id) {
+        pq.push((uint64_t)dist << 32 | id);
+    }
+
+    bool pop(Node &out) {
+        if (pq.empty()) {
+            return false;
+        }
+        uint64_t key = pq.top();
+        pq.pop();
+        out.dist = (uint32_t)(key >> 32);
+        out.id = (uint32_t)key;
+        return true;
+    }
+};
+
+// Indexed 4-ary heap with decrease-key: every id is queued at most once,
+// so there are no duplicate entries and no stale pops.  ids() sizes the
+// position index before the first push.
+struct IndexedHeap {
+    static constexpr uint32_t span = INF; // any edge cost
+
+    std::vector<Node> heap;
+    std::vector<uint32_t> pos; // slot per id, INF when not queued
+
+    void ids(size_t n) { pos.assign(n, INF); }
+
+    void push(uint32_t dist, uint32_t id) {
+        uint32_t i = pos[id];
+        if (i == INF) {
+            i = (uint32_t)heap.size();
+            heap.push_back(Node{dist, id});
+        } else if (heap[i].dist <= dist) {
+            return;
+        }
+        up(i, Node{dist, id});
+    }
+
+    bool pop(Node &out) {
+        if (heap.empty()) {
+            return false;
+        }
+        out = heap[0];
+        pos[out.id] = INF;
+        Node last = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) {
+            down(0, last);
+        }
+        return true;
+    }
+
+private:
+    void place(uint32_t i, Node n) {
+        heap[i] = n;
+        pos[n.id] = i;
+    }
+
+    void up(uint32_t i, Node n) {
+        while (i > 0) {
+            uint32_t p = (i - 1) / 4;
+            if (heap[p].dist <= n.dist) {
+                break;
+            }
+            place(i, heap[p]);
+            i = p;
+        }
+        place(i, n);
+    }
+
+    void down(uint32_t i, Node n) {
+        uint32_t size = (uint32_t)heap.size();
+        for (;;) {
+            uint32_t c = 4 * i + 1;
+            uint32_t end = std::min(c + 4, size);
+            uint32_t best = i;
+            uint32_t bdist = n.dist;
+            for (; c < end; ++c) {
+                if (heap[c].dist < bdist) {
+                    best = c;
+                    bdist = heap[c].dist;
+                }
+            }
+            if (best == i) {
+                break;
+            }
+            place(i, heap[best]);
+            i = best;
+        }
+        place(i, n);
+    }
+};
+
+// Circular bucket queue for monotone keys that never run more than
+// Span - 1 ahead of the last key popped: each key gets its own bucket.
+template <uint32_t Span>
+struct BucketQueue {
+    static constexpr uint32_t span = Span;
+
+    std::vector<std::vector<uint32_t>> buckets;
+    uint32_t cur = 0;
+    size_t size = 0;
+
+    BucketQueue() : buckets(Span) {}
+
+    void push(uint32_t dist, uint32_t id) {
+        if (size == 0) {
+            cur = dist; // keys are monotone, so nothing below dist follows
+        }
+        buckets[dist % Span].push_back(id);
+        ++size;
+    }
+
+    bool pop(Node &out) {
+        if (size == 0) {
+            return false;
+        }
+        while (buckets[cur % Span].empty()) {
+            ++cur;
+        }
+        std::vector<uint32_t> &b = buckets[cur % Span];
+        out.dist = cur;
+        out.id = b.back();
+        b.pop_back();
+        --size;
+        return true;
+    }
+};
+
+// Dial's algorithm for a cost policy: one bucket per pending distance.
+template <class Costs>
+using DialQueue = BucketQueue<Costs::max_edge + 1>;
+
+// 0-1 BFS: with edge costs 0 and 1 the pending keys span two values, so
+// a deque ordered by pushing the lower one at the front suffices.
+struct ZeroOneQueue {
+    static constexpr uint32_t span = 2;
+
+    std::deque<Node> dq;
+
+    void push(uint32_t dist, uint32_t id) {
+        if (!dq.empty() && dist <= dq.front().dist) {
+            dq.push_front(Node{dist, id});
+        } else {
+            dq.push_back(Node{dist, id});
+        }
+    }
+
+    bool pop(Node &out) {
+        if (dq.empty()) {
+            return false;
+        }
+        out = dq.front();
+        dq.pop_front();
+        return true;
+    }
+};
+
+// ------------------------------------------------------------------ search
+
+// Costs are kept in 32 bits; refuse to settle a state whose successors
+// could wrap around.
+inline void check_cost(uint32_t cost, uint32_t max_edge) {
+    if (cost > INF - 1 - max_edge) {
+        fprintf(stderr, "path cost overflows 32 bits\n");
+        exit(1);
+    }
+}
+
+// Dijkstra over graph g from every id in sources at distance 0, along
+// the edges (D == Dir::forward) or against them (D == Dir::reverse).
+template <Dir D, class Queue, class Graph, class Sources>
+DistArray search(const Graph &g, const Sources &sources) {
+    if (g.max_edge() >= Queue::span) {
+        fprintf(stderr, "edge cost %u too large for the queue\n", g.max_edge());
+        exit(1);
+    }
+
+    DistArray dist(g.states(), INF);
+    Queue pq;
+
+    if constexpr (requires { pq.ids(g.states()); }) {
+        pq.ids(g.states());
+    }
+    for (uint32_t s : sources) {
+        dist[s] = 0;
+        pq.push(0, s);
+    }
+
+    Node cur;
+    while (pq.pop(cur)) {
+        uint32_t cost = cur.dist;
+        uint32_t id = cur.id;
+
+        if (cost != dist[id]) {
+            continue; // stale
+        }
+        check_cost(cost, g.max_edge());
+
+        g.template each<D>(id, [&](uint32_t nid, uint32_t w) {
+            uint32_t ncost = cost + w;
+            if (ncost < dist[nid]) {
+                dist[nid] = ncost;
+                pq.push(ncost, nid);
+            }
+        });
+    }
+
+    return dist;
+}
+
+} // namespace gridsearch
+
+#endif
@@ -0,0 +1,52 @@
+# Build profiles, included by every solver Makefile after its flags and
+# before its first rule.
+#
+#   make                    the directory's own OPT, into .
+#   make PROFILE=debug      -O0 -ggdb, every assertion tier, into debug/
+#   make PROFILE=release    -O2 -flto, into release/; with -fprofile-use
+#                           too once release/pgo holds a training run
+#   make PROFILE=release PGO=generate
+#                           instrumented release build that writes its
+#                           profile to release/pgo when it exits
+#
+# The profiles build into their own directories so one never has to be
+# cleaned to get the other back.  lib/benchsuite.py pgo drives the
+# release cycle (instrument, train on the suite inputs, rebuild) for
+# every solver at once.  PGO=none builds release with LTO alone.  The
+# profile flags are GCC's: a clang build takes PROFILE=release PGO=none.
+
+ifneq ($(PROFILE),)
+OUT := $(PROFILE)/
+endif
+
+ifeq ($(PROFILE),debug)
+OPT := -O0 -ggdb
+ASSERT_LEVEL := 2
+else ifeq ($(PROFILE),release)
+PGO_DIR := $(CURDIR)/release/pgo
+PGO ?= $(if $(wildcard $(PGO_DIR)/*.gcda),use,none)
+OPT := -O2 -flto=auto
+# counters are shared between the worker threads of day11 and day16
+ifeq ($(PGO),generate)
+OPT += -fprofile-generate=$(PGO_DIR) -fprofile-update=atomic
+else ifeq ($(PGO),use)
+# functions edited since training warn and build without their profile
+OPT += -fprofile-use=$(PGO_DIR) -fprofile-partial-training -Wno-missing-profile \
+       -Wno-error=coverage-mismatch
+else ifneq ($(PGO),none)
+$(error PGO must be generate, use or none)
+endif
+else ifneq ($(PROFILE),)
+$(error PROFILE must be debug or release)
+endif
+
+# a change of flags within a profile (PGO=generate, then use) rebuilds;
+# the rules here must not become the including Makefile's default goal
+$(OUT).flags: FORCE
+	@mkdir -p $(@D)
+	@echo '$(CC) $(CXX) $(CFLAGS) $(CXXFLAGS) $(CPPFLAGS)' | cmp -s - $@ || \
+	  echo '$(CC) $(CXX) $(CFLAGS) $(CXXFLAGS) $(CPPFLAGS)' > $@
+
+FORCE:
+.PHONY: FORCE
+.DEFAULT_GOAL :=
@@ -2,48 +2,104 @@
 #include <libc.h>
 #include <bio.h>
 
+/*
+ * Day 1: Historian Hysteria.
+ *
+ * Both columns are loaded into arrays that grow geometrically, sorted
+ * with an LSD radix sort (four byte-wide counting passes, O(n)), and
+ * then both parts are single passes over the sorted arrays: part 1 pairs
+ * them up index by index, part 2 merges equal runs, adding v * a * b for
+ * a value v seen a times on the left and b times on the right.  Nothing
+ * is indexed by value, so large location ids cost nothing extra.
+ */
 
 typedef struct {
   int *l;
   int *r;
   int lcount;
   int rcount;
+  int cap;
 } Input;
 
+/* parse an optionally signed decimal at *s, skipping leading blanks */
+static int
+parseint(char **s, int *out)
+{
+  char *p;
+  int neg;
+  uint v;
+
+  p = *s;
+  while (*p == ' ' || *p == '\t')
+    p++;
+  neg = 0;
+  if (*p == '-' || *p == '+')
+    neg = *p++ == '-';
+  if (*p < '0' || *p > '9')
+    return 0;
+  v = 0;
+  while (*p >= '0' && *p <= '9')
+    v = v * 10 + (*p++ - '0');
+  *out = neg ? -(int)v : (int)v;
+  *s = p;
+  return 1;
+}
+
+/* make room for one more pair, doubling the capacity when full */
+static int
+grow(Input *data)
+{
+  int cap, *l, *r;
+
+  if (data->lcount < data->cap)
+    return 0;
+  cap = data->cap ? data->cap * 2 : 4096;
+  l = realloc(data->l, cap * sizeof(int));
+  if (l == nil)
+    return -1;
+  data->l = l;
+  r = realloc(data->r, cap * sizeof(int));
+  if (r == nil)
+    return -1;
+  data->r = r;
+  data->cap = cap;
+  return 0;
+}
+
 int
 slurp(Input *data, char *filename)
 {
   Biobuf *buf;
-  char *line;
+  char *line, *p;
+  int n, lval, rval;
 
   buf = Bopen(filename, OREAD);
   if (buf == nil){
-    fprint(2, "oops: %s\n", filename);  
+    fprint(2, "oops: %s\n", filename);
     return -1;
   }
   data->l = nil;
   data->r = nil;
   data->lcount = 0;
   data->rcount = 0;
+  data->cap = 0;
 
   while ((line = Brdline(buf, '\n')) != nil){
-    char *lval, *rval;
-    line[Blinelen(buf) - 1] = '\0'; // trailing newline
-    lval = strtok(line, " ");
-    rval = strtok(nil, " ");
-
-    if (!lval || !rval){
-      fprint(2, "oops line: %s:, line");
+    n = Blinelen(buf);
+    line[n - 1] = '\0'; // trailing newline
+    if (n > 1 && line[n - 2] == '\r')
+      line[n - 2] = '\0';
+    p = line;
+
+    if (!parseint(&p, &lval) || !parseint(&p, &rval)){
+      fprint(2, "oops line: %s\n", line);
       free(data->l);
       free(data->r);
       Bterm(buf);
       return -1;
      }
 
-    int *new_l = realloc(data->l, (data->lcount + 1) * sizeof(int));
-    int *new_r = realloc(data->r, (data->rcount + 1) * sizeof(int));
-
-    if (!new_l || !new_r) {
+    if (grow(data) < 0) {
     	fprint(2, "realloc failed\n");
     	free(data->l);
     	free(data->r);
@@ -51,91 +107,124 @@ slurp(Input *data, char *filename)
     	return -1;
     }
 
-    data->l = new_l;
-    data->r = new_r;
-
-	  data->l[data->lcount++] = atoi(lval);
-	  data->r[data->rcount++] = atoi(rval);
+	  data->l[data->lcount++] = lval;
+	  data->r[data->rcount++] = rval;
   }
   Bterm(buf);
   return 0;
 }
 
-void
-sort(int *arr, int count) {
-	for (int i = 0; i < count - 1; i++) {
-		for (int j = 0; j < count - i - 1; j++) {
-			if (arr[j] > arr[j + 1]) {
-				int temp = arr[j];
-				arr[j] = arr[j + 1];
-				arr[j+1] = temp;
-			}
+/*
+ * LSD radix sort, 8 bits per pass.  The sign bit is flipped so negative
+ * values order below positive ones; a pass whose digit is the same for
+ * every element is skipped.
+ */
+int
+sort(int *arr, int count)
+{
+	uint *a, *b, *t;
+	int cnt[256];
+	int shift, i, d, sum, c;
+
+	if (count < 2)
+		return 0;
+	b = malloc(count * sizeof(uint));
+	if (b == nil)
+		return -1;
+	a = (uint*)arr;
+	for (i = 0; i < count; i++)
+		a[i] ^= 0x80000000;
+
+	for (shift = 0; shift < 32; shift += 8) {
+		memset(cnt, 0, sizeof cnt);
+		for (i = 0; i < count; i++)
+			cnt[(a[i] >> shift) & 0xFF]++;
+		if (cnt[(a[0] >> shift) & 0xFF] == count)
+			continue;
+		sum = 0;
+		for (d = 0; d < 256; d++) {
+			c = cnt[d];
+			cnt[d] = sum;
+			sum += c;
 		}
+		for (i = 0; i < count; i++)
+			b[cnt[(a[i] >> shift) & 0xFF]++] = a[i];
+		t = a;
+		a = b;
+		b = t;
 	}
+
+	if (a != (uint*)arr) {
+		memmove(arr, a, count * sizeof(uint));
+		b = a;
+	}
+	for (i = 0; i < count; i++)
+		arr[i] ^= 0x80000000;
+	free(b);
+	return 0;
 }
 
-int
+vlong
 calc_dist(Input *data) {
-	sort(data->l, data->lcount);
-	sort(data->r, data->rcount);
+	vlong diff = 0;
 
-	int diff = 0;
 	for (int i = 0; i < data->lcount; i++) {
-		diff += abs(data->l[i] - data->r[i]);
+		vlong d = (vlong)data->l[i] - data->r[i];
+		diff += d < 0 ? -d : d;
 	}
 	return diff;
 }
 
-int
+/* merge equal runs of the two sorted lists */
+vlong
 sim_score(Input *data) {
-	int score = 0;
-	int max_r = 0;
-		
-	for (int i = 0; i < data->rcount; i++) {
-			if (data->r[i] > max_r) max_r = data->r[i];
-	}
-
-	
-	int *counts = calloc(max_r + 1, sizeof(int));
-	if (!counts) {
-			fprint(2, "calloc failed\n");
-			return -1;
-	}
-
-	for (int i = 0; i < data->rcount; i++) {
-		counts[data->r[i]]++;
-	}
-
-	for (int i = 0; i < data->lcount; i++) {
-		if (data->l[i] <= max_r)
-				score += data->l[i] * counts[data->l[i]];
+	vlong score = 0;
+	int i = 0, j = 0;
+
+	while (i < data->lcount && j < data->rcount) {
+		int v = data->l[i];
+		if (v < data->r[j]) {
+			i++;
+		} else if (v > data->r[j]) {
+			j++;
+		} else {
+			vlong a = 0, b = 0;
+			while (i < data->lcount && data->l[i] == v) {
+				a++;
+				i++;
+			}
+			while (j < data->rcount && data->r[j] == v) {
+				b++;
+				j++;
+			}
+			score += v * a * b;
+		}
 	}
-
-	free(counts);
 	return score;
 }
 
 void
-main() {
+main(int argc, char *argv[]) {
 	Input data;
+	char *fn = argc > 1 ? argv[1] : "input.txt";
 
-	if (slurp(&data, "input.txt") < 0) {
+	if (slurp(&data, fn) < 0) {
 		fprint(2, "File Not Found\n");
 		exits("error");
 	}
 
-	int dist = calc_dist(&data);
-	int sim = sim_score(&data);
-
-	if (sim < 0) {
-		fprint(2, "sim score failed\n");
+	if (sort(data.l, data.lcount) < 0 || sort(data.r, data.rcount) < 0) {
+		fprint(2, "sort failed\n");
 		free(data.l);
 		free(data.r);
 		exits("error");
 	}
 
-	print("Part I: \t%d\n", dist);
-	print("Part II:\t%d\n", sim);
+	vlong dist = calc_dist(&data);
+	vlong sim = sim_score(&data);
+
+	print("Part I: \t%lld\n", dist);
+	print("Part II:\t%lld\n", sim);
 
 	free(data.l);
 	free(data.r);
@@ -4,14 +4,24 @@
 #include <libc.h>
 #include <bio.h>
 
+/*
+ * Reports are streamed: each line is parsed into a stack buffer of at
+ * most MAXLEVELS levels, checked, and forgotten, so memory stays the
+ * same whatever the size of the log.
+ *
+ * Dampened safety is decided in O(n) per direction.  With ok(a, b) the
+ * adjacency/monotonicity test for one pair, pre[i] says levels 0..i
+ * form a safe run and suf[i] says levels i..n-1 do; dropping level k
+ * leaves a safe report iff the run before k, the run after k and the
+ * pair bridging k are all safe.
+ */
+
+enum { MAXLEVELS = 256 };
+
 typedef struct {
-	int **data;
-	int rows;
-	int *cols;
-	int **orig_report;
-	int orig_rows;
-	char **damped_report;
-	int damped_rows;
+	vlong reports;
+	vlong safe;
+	vlong damped;	/* safe with at most one level removed */
 } Input;
 
 void
@@ -45,10 +55,135 @@ is_safe(int *row, int n)
 		if (diff == 0)
 			return 0;
 	}
-	
+
 	return 1;
 }
 
+/* a -> b is a safe step in direction sgn (+1 increasing, -1 decreasing) */
+static int
+ok(int a, int b, int sgn)
+{
+	int diff = (b - a) * sgn;
+
+	return diff >= 1 && diff <= 3;
+}
+
+/* safe in direction sgn after removing at most one level */
+static int
+damped_dir(int *row, int n, int sgn)
+{
+	uchar pre[MAXLEVELS], suf[MAXLEVELS];
+
+	pre[0] = 1;
+	for (int i = 1; i < n; i++)
+		pre[i] = pre[i - 1] && ok(row[i - 1], row[i], sgn);
+	suf[n - 1] = 1;
+	for (int i = n - 2; i >= 0; i--)
+		suf[i] = suf[i + 1] && ok(row[i], row[i + 1], sgn);
+
+	if (pre[n - 1] || suf[1] || pre[n - 2])
+		return 1;	// nothing, the first or the last level removed
+	for (int k = 1; k < n - 1; k++) {
+		if (pre[k - 1] && suf[k + 1] && ok(row[k - 1], row[k + 1], sgn))
+			return 1;
+	}
+	return 0;
+}
+
+int
+is_damped_safe(int *row, int n)
+{
+	if (n <= 2)
+		return 1;
+	return damped_dir(row, n, 1) || damped_dir(row, n, -1);
+}
+
+void
+analysis(Input *data, int *row, int n)
+{
+	data->reports++;
+	if (is_safe(row, n)) {
+		data->safe++;
+		data->damped++;
+	} else if (is_damped_safe(row, n)) {
+		data->damped++;
+	}
+}
+
+/* parse the levels on line into row; returns their count, or -1 */
+static int
+parse_levels(char *line, int *row)
+{
+	char *p = line;
+	int n = 0;
+
+	for (;;) {
+		while (*p == ' ' || *p == '\t' || *p == '\r')
+			p++;
+		if (*p == '\0')
+			return n;
+		if (n == MAXLEVELS)
+			return -1;
+
+		int neg = *p == '-';
+		if (neg)
+			p++;
+		if (*p < '0' || *p > '9')
+			return -1;
+		int v = 0;
+		while (*p >= '0' && *p <= '9')
+			v = v * 10 + (*p++ - '0');
+		row[n++] = neg ? -v : v;
+	}
+}
+
+static void
+report_line(Input *data, char *line, vlong lineno)
+{
+	int row[MAXLEVELS];
+	int n = parse_levels(line, row);
+
+	if (n < 0) {
+		fprint(2, "line %lld: bad or too many levels\n", lineno);
+		exits("error");
+	}
+	if (n > 0)
+		analysis(data, row, n);
+}
+
+void
+slurp(Input *data, char *fn)
+{
+	Biobuf *buf;
+	char *line;
+	vlong lineno = 0;
+
+	buf = Bopen(fn, OREAD);
+	if (buf == nil)
+		die("cannot open input");
+
+	memset(data, 0, sizeof *data);
+	for (;;) {
+		if ((line = Brdline(buf, '\n')) != nil) {
+			line[Blinelen(buf) - 1] = '\0';
+			report_line(data, line, ++lineno);
+		} else if (Blinelen(buf) > 0 && (line = Brdstr(buf, '\n', 1)) != nil) {
+			// last line without a newline, or one longer than the buffer
+			report_line(data, line, ++lineno);
+			free(line);
+		} else
+			break;
+	}
+	Bterm(buf);
+}
+
+void
+print_reports(Input *data)
+{
+	print("Reports:\t%lld\n", data->reports);
+	print("Part I: \t%lld\n", data->safe);
+	print("Part II:\t%lld\n", data->damped);
+}
 
 void
 main(int argc, char *argv[])
@@ -59,20 +194,8 @@ main(int argc, char *argv[])
 	char *fn = argv[1];
 	Input data;
 
-	slurp(&data, fn); //TODO
-	analysis(&data); //TODO
-	print_reports(&data); //TODO
-
-	// free everything
-	for (int i = 0; i < data.rows; i++)
-		free(data.data[i]);
-	free(data.data);
-	free(data.cols);
-
-
-	for (int i = 0; i < data.damped_rows; i++)
-		free(data.damped_report[i]);
-	free(data.damped_report);
+	slurp(&data, fn);
+	print_reports(&data);
 
 	exits(0);
 }